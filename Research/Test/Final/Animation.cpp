@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Animation.h"
 
 const Transform Bone::m_parent = Transform();
@@ -12,6 +14,22 @@ QuaternionKey::QuaternionKey(Quaternion value, float timeStamp)
 	, timeStamp	(timeStamp)
 { }
 
+AnimationCursor::AnimationCursor()
+	: position	(1)
+	, scaling	(1)
+	, rotation	(1)
+{ }
+
+Animation::Animation()
+	: name			()
+	, positions		()
+	, scalings		()
+	, rotations		()
+	, duration		(0.0f)
+	, ticksPerSecond	(0.0f)
+	, keyInterval	(0.0f)
+{ }
+
 void
 Animation::printAnimation()
 {
@@ -21,70 +39,211 @@ Animation::printAnimation()
 	std::cout << "Num of Rotations 	= " << rotations.size() << std::endl;
 }
 
+namespace
+{
+	// Index of the first key after time, searching from 1, or keys.size()
+	// 	when there is none. Times before the first key use the first pair.
+	template<typename Key>
+	unsigned
+	findKey(const std::vector<Key>& keys, float time, unsigned& cursor, float keyInterval)
+	{
+		const unsigned size = keys.size();
+		if (size < 2 || time >= keys.back().timeStamp)
+		{
+			return size;
+		}
+
+		if (keyInterval > 0.0f)
+		{
+			const float offset = (time - keys[0].timeStamp) / keyInterval;
+			const unsigned index = offset < 0.0f ? 1 : static_cast<unsigned> (offset) + 1;
+			return index < size - 1 ? index : size - 1;
+		}
+
+		unsigned index = cursor;
+		if (index >= 1 && index < size && (index == 1 || keys[index - 1].timeStamp <= time))
+		{
+			for (unsigned step = 0; step < Animation::MAX_CURSOR_STEPS && keys[index].timeStamp <= time; ++step)
+			{
+				++index;
+			}
+			if (keys[index].timeStamp > time)
+			{
+				cursor = index;
+				return index;
+			}
+		}
+
+		// Seeked, looped or too far ahead
+		index = std::upper_bound(keys.begin() + 1, keys.end(), time,
+			[](float t, const Key& key) { return t < key.timeStamp; }) - keys.begin();
+		cursor = index;
+		return index;
+	}
+
+	template<typename Key>
+	float
+	blendAt(const std::vector<Key>& keys, unsigned index, float time)
+	{
+		float totalTime = keys[index].timeStamp - keys[index - 1].timeStamp;
+		float currTime = time - keys[index - 1].timeStamp;
+		return currTime / totalTime;
+	}
+
+	// Keys every keyInterval from the first key, plus the last key so the
+	// 	track still ends where it did
+	template<typename Key, typename Sample>
+	void
+	resampleTrack(std::vector<Key>& keys, float keyInterval, Sample sample)
+	{
+		if (keys.size() < 2)
+		{
+			return;
+		}
+		const float begin = keys.front().timeStamp;
+		const float end = keys.back().timeStamp;
+		std::vector<Key> resampled;
+		resampled.reserve(static_cast<unsigned> ((end - begin) / keyInterval) + 2);
+		unsigned cursor = 1;
+		for (unsigned i = 0; begin + i * keyInterval < end; ++i)
+		{
+			const float time = begin + i * keyInterval;
+			resampled.push_back(Key(sample(time, cursor), time));
+		}
+		resampled.push_back(keys.back());
+		keys.swap(resampled);
+	}
+}
+
 Transform
 Animation::getAnimationMatrix(float time)
 {
-	//std::cout << time << std::endl;
-	Transform animation(getPosition(time), getRotationMatrix(time));
-	animation.innerScale(getScaleMatrix(time));
+	AnimationCursor cursor;
+	return getAnimationMatrix(time, cursor);
+}
+
+Transform
+Animation::getAnimationMatrix(float time, AnimationCursor& cursor)
+{
+	Vector3 position;
+	Quaternion rotation(0.0f, 0.0f, 0.0f, 1.0f);
+	Vector3 scale;
+	getLocalPose(time, cursor, position, rotation, scale);
+	Transform animation(position, rotation.toMatrix3());
+	animation.innerScale(scale);
 	return animation;
 }
 
+void
+Animation::getLocalPose(float time, AnimationCursor& cursor, Vector3& position, Quaternion& rotation,
+	Vector3& scale)
+{
+	position = getPosition(time, cursor.position);
+	rotation = getRotation(time, cursor.rotation);
+	scale = getScaleMatrix(time, cursor.scaling);
+}
+
 Vector3
 Animation::getPosition(const float time)
 {
-	for (unsigned index = 1; index < positions.size(); ++index)
+	unsigned cursor = 0;
+	return getPosition(time, cursor);
+}
+
+Vector3
+Animation::getPosition(const float time, unsigned& cursor)
+{
+	if (positions.empty())
 	{
-		if (positions[index].timeStamp > time)
-		{
-			// std::cout << "Position Index = " << index << std::endl;
-			float totalTime = positions[index].timeStamp - positions[index - 1].timeStamp;
-			float currTime = time - positions[index - 1].timeStamp;
-			float blend = currTime / totalTime;
-			Vector3 next = positions[index    ].value;
-			Vector3 prev = positions[index - 1].value;
-			return prev.interpolate(next, blend);
-		}
+		return Vector3();
 	}
-	return Vector3();
+	const unsigned index = findKey(positions, time, cursor, keyInterval);
+	if (index >= positions.size())
+	{
+		return positions.back().value;
+	}
+	Vector3 next = positions[index    ].value;
+	Vector3 prev = positions[index - 1].value;
+	return prev.interpolate(next, blendAt(positions, index, time));
 }
 
 Vector3
 Animation::getScaleMatrix(const float time)
 {
-	for (unsigned index = 1; index < scalings.size(); ++index)
+	unsigned cursor = 0;
+	return getScaleMatrix(time, cursor);
+}
+
+Vector3
+Animation::getScaleMatrix(const float time, unsigned& cursor)
+{
+	if (scalings.empty())
 	{
-		if (scalings[index].timeStamp > time)
-		{
-			// std::cout << "Scale Index = " << index << std::endl;
-			float totalTime = scalings[index].timeStamp - scalings[index - 1].timeStamp;
-			float currTime = time - scalings[index - 1].timeStamp;
-			float blend = currTime / totalTime;
-			Vector3 next = scalings[index    ].value;
-			Vector3 prev = scalings[index - 1].value;
-			return prev.interpolate(next, blend);
-		}
+		return Vector3(1.0f, 1.0f, 1.0f);
+	}
+	const unsigned index = findKey(scalings, time, cursor, keyInterval);
+	if (index >= scalings.size())
+	{
+		return scalings.back().value;
 	}
-	return Vector3();
+	Vector3 next = scalings[index    ].value;
+	Vector3 prev = scalings[index - 1].value;
+	return prev.interpolate(next, blendAt(scalings, index, time));
 }
 
 Matrix3
 Animation::getRotationMatrix(const float time)
 {
-	for (unsigned index = 1; index < rotations.size(); ++index)
+	unsigned cursor = 0;
+	return getRotation(time, cursor).toMatrix3();
+}
+
+Matrix3
+Animation::getRotationMatrix(const float time, unsigned& cursor)
+{
+	return getRotation(time, cursor).toMatrix3();
+}
+
+Quaternion
+Animation::getRotation(const float time, unsigned& cursor)
+{
+	if (rotations.empty())
 	{
-		if (rotations[index].timeStamp > time)
-		{
-			// std::cout << "Rotation Index = " << index << std::endl;
-			float totalTime = rotations[index].timeStamp - rotations[index - 1].timeStamp;
-			float currTime = time - rotations[index - 1].timeStamp;
-			float blend = currTime / totalTime;
-			Quaternion next = rotations[index    ].value;
-			Quaternion prev = rotations[index - 1].value;
-			return prev.interpolate(next, blend).toMatrix3();
-		}
+		return Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	const unsigned index = findKey(rotations, time, cursor, keyInterval);
+	if (index >= rotations.size())
+	{
+		return rotations.back().value;
+	}
+	Quaternion next = rotations[index    ].value;
+	Quaternion prev = rotations[index - 1].value;
+	return prev.interpolate(next, blendAt(rotations, index, time));
+}
+
+void
+Animation::resample(float keysPerTick)
+{
+	if (keysPerTick <= 0.0f)
+	{
+		return;
 	}
-	return Matrix3();
+	const float interval = 1.0f / keysPerTick;
+	// Sample the imported keys before the lookup switches to the grid
+	keyInterval = 0.0f;
+	resampleTrack(positions, interval, [this](float time, unsigned& cursor)
+	{
+		return getPosition(time, cursor);
+	});
+	resampleTrack(scalings, interval, [this](float time, unsigned& cursor)
+	{
+		return getScaleMatrix(time, cursor);
+	});
+	resampleTrack(rotations, interval, [this](float time, unsigned& cursor)
+	{
+		return getRotation(time, cursor);
+	});
+	keyInterval = interval;
 }
 
 Bone::Bone(std::string name, const Transform& bind, const Transform& global, const Transform& local)
@@ -116,12 +275,23 @@ Bone::addChild(Bone* child)
 
 void
 Bone::setUniforms(ShaderProgram* shaderProgram)
+{
+	std::vector<Matrix4> palette;
+	getPalette(palette);
+	const unsigned count = palette.size() < MAX_BONES ? palette.size() : MAX_BONES;
+	shaderProgram->setUniform("uBones", palette.data(), count);
+}
+
+void
+Bone::getPalette(std::vector<Matrix4>& palette)
 {
 	std::vector<Transform> transforms;
 	this->getTransforms(transforms, Transform());
-	for (unsigned i = 0; i < transforms.size(); ++i)
+	palette.clear();
+	palette.reserve(transforms.size());
+	for (const Transform& transform : transforms)
 	{
-		shaderProgram->setUniform("uBones[" + std::to_string(i) + "]", transforms[i].getTransform());
+		palette.push_back(transform.getTransform());
 	}
 }
 
@@ -168,8 +338,42 @@ Bone::update(float deltaTime)
 void
 Bone::setAnimation(float deltaTime)
 {
+	// Bones without a channel in any clip hold their local pose
+	if (animations.empty())
+	{
+		animation = local;
+		return;
+	}
     time = fmod(time + deltaTime, animations[index].duration);
-	animation = animations[index].getAnimationMatrix(time);
+	animation = animations[index].getAnimationMatrix(time, cursor);
+}
+
+void
+Bone::resampleAnimations(float keysPerTick)
+{
+	for (Animation& clip : animations)
+	{
+		clip.resample(keysPerTick);
+	}
+	for (Bone* child : children)
+	{
+		child->resampleAnimations(keysPerTick);
+	}
+}
+
+void
+Bone::releaseKeys()
+{
+	for (Animation& clip : animations)
+	{
+		std::vector<Vector3Key>().swap(clip.positions);
+		std::vector<Vector3Key>().swap(clip.scalings);
+		std::vector<QuaternionKey>().swap(clip.rotations);
+	}
+	for (Bone* child : children)
+	{
+		child->releaseKeys();
+	}
 }
 
 unsigned
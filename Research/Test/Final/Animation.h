@@ -25,14 +25,29 @@ struct QuaternionKey
 	float timeStamp;
 };
 
+// Key each track of an Animation was last sampled at, kept by whoever plays
+// 	it so steady playback only steps forward a key or two per frame
+struct AnimationCursor
+{
+	AnimationCursor();
+
+	unsigned position;
+	unsigned scaling;
+	unsigned rotation;
+};
+
 struct Animation
 {
+	Animation();
+
 	std::string name;
 	std::vector<Vector3Key> positions;
 	std::vector<Vector3Key> scalings;
 	std::vector<QuaternionKey> rotations;
 	float duration;
 	float ticksPerSecond;
+	// Time between keys once resampled, 0 while keys keep their imported times
+	float keyInterval;
 
 	void
 	printAnimation();
@@ -40,14 +55,44 @@ struct Animation
 	Transform
 	getAnimationMatrix(float time);
 
+	Transform
+	getAnimationMatrix(float time, AnimationCursor& cursor);
+
+	// Without a cursor the keys are binary searched. Tracks hold their last
+	// 	key past its time and an empty track is the identity.
 	Vector3
 	getPosition(float time);
 
+	Vector3
+	getPosition(float time, unsigned& cursor);
+
 	Vector3
 	getScaleMatrix(float time);
 
+	Vector3
+	getScaleMatrix(float time, unsigned& cursor);
+
 	Matrix3
 	getRotationMatrix(float time);
+
+	Matrix3
+	getRotationMatrix(float time, unsigned& cursor);
+
+	Quaternion
+	getRotation(float time, unsigned& cursor);
+
+	// Every track sampled at time, for poses kept as separate components
+	void
+	getLocalPose(float time, AnimationCursor& cursor, Vector3& position, Quaternion& rotation, Vector3& scale);
+
+	// Replace each track's keys with keys every 1 / keysPerTick ticks, so the
+	// 	key for a time is computed instead of searched. Lossy where the
+	// 	imported keys were not already on that grid.
+	void
+	resample(float keysPerTick);
+
+	// Cursor steps tried before falling back to a binary search
+	static constexpr unsigned MAX_CURSOR_STEPS = 4;
 };
 
 class Bone
@@ -73,9 +118,24 @@ public:
 	void
 	reset();
 
+	// Resample every animation of this bone and its children, see
+	// 	Animation::resample
+	void
+	resampleAnimations(float keysPerTick);
+
+	// Free the keys of every animation below this bone, keeping names and
+	// 	durations, once a Skeleton samples from its CompressedClip instead
+	void
+	releaseKeys();
+
+	// Uploads the whole palette to uBones with one call
 	void
 	setUniforms(ShaderProgram* shaderProgram);
 
+	// Skinning matrix of every bone, in the order uBones expects
+	void
+	getPalette(std::vector<Matrix4>& palette);
+
 	void
 	getTransforms(std::vector<Transform>& transforms, const Transform& parent);
 
@@ -88,8 +148,12 @@ public:
 public:
 	const std::string name;
 
+	// Size of uBones in Vec3Norm.vert
+	static constexpr unsigned MAX_BONES = 50;
+
 private:
 	Transform animation;
+	AnimationCursor cursor;
 
 public:
 	 Transform bind;
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+
+#include "AnimationLod.h"
+#include "BoundsBatch.h"
+#include "Math.h"
+#include "Model.h"
+
+/****************************************************************************************/
+// AnimationLodSettings Struct
+
+AnimationLodSettings::AnimationLodSettings()
+: fullSize(0.25f)
+, halfSize(0.1f)
+{ }
+
+/****************************************************************************************/
+// AnimationLod Class
+
+AnimationLod::Stats::Stats()
+: levels()
+, evaluated(0)
+, blended(0)
+{ }
+
+AnimationLod::AnimationLod(const AnimationLodSettings& settings)
+: m_settings(settings)
+, m_frame()
+, m_lastFrame()
+{ }
+
+AnimationLod::Level
+AnimationLod::chooseLevel(Model& model, const Camera& camera,
+	const std::vector<uint64_t>* visible, unsigned first) const
+{
+	const Transform& view = camera.getViewMatrix(true);
+	const float tanHalfFov = std::tan(Math::toRadians(camera.getYFOV()) / 2.0f);
+	bool isVisible = false;
+	float largest = 0.0f;
+	for (unsigned t = 0; t < model.numTransforms(); ++t)
+	{
+		if (visible != nullptr && !BoundsBatch::isVisible(*visible, first + t))
+		{
+			continue;
+		}
+		isVisible = true;
+
+		const Transform& world = model.getTransform(t);
+		const Matrix3& orientation = world.getOrientation(true);
+		const float scale = std::max(orientation.getRight().length(),
+			std::max(orientation.getUp().length(), orientation.getBack().length()));
+		const Vector3 center = orientation.transform(model.getCenter()) + world.getPosition();
+		const float radius = model.getRadius() * scale;
+
+		// The view has no scale so depth and radius stay in world units
+		const float depth = -(view.getOrientation(true).transform(center) + view.getPosition()).z;
+		if (depth <= radius)
+		{
+			return Level::FULL;
+		}
+		largest = std::max(largest, radius / (depth * tanHalfFov));
+	}
+
+	if (!isVisible)
+	{
+		return Level::FROZEN;
+	}
+	if (largest >= m_settings.fullSize)
+	{
+		return Level::FULL;
+	}
+	return largest >= m_settings.halfSize ? Level::HALF : Level::QUARTER;
+}
+
+void
+AnimationLod::record(Level level, bool isEvaluated)
+{
+	++m_frame.levels[static_cast<unsigned> (level)];
+	if (isEvaluated)
+	{
+		++m_frame.evaluated;
+	}
+	else if (level != Level::FROZEN)
+	{
+		++m_frame.blended;
+	}
+}
+
+unsigned
+AnimationLod::period(Level level)
+{
+	switch (level)
+	{
+	case Level::FULL:
+		return 1;
+	case Level::HALF:
+		return 2;
+	case Level::QUARTER:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+void
+AnimationLod::beginFrame()
+{
+	m_lastFrame = m_frame;
+	m_frame = Stats();
+}
+
+const AnimationLod::Stats&
+AnimationLod::getLastFrameStats() const
+{
+	return m_lastFrame;
+}
+
+void
+AnimationLod::printStats(std::ostream& out) const
+{
+	const Stats& stats = m_lastFrame;
+	out << "Animation LOD: "
+		<< stats.levels[static_cast<unsigned> (Level::FULL)] << " every frame, "
+		<< stats.levels[static_cast<unsigned> (Level::HALF)] << " every 2nd, "
+		<< stats.levels[static_cast<unsigned> (Level::QUARTER)] << " every 4th, "
+		<< stats.levels[static_cast<unsigned> (Level::FROZEN)] << " frozen, "
+		<< stats.evaluated << " evaluated, "
+		<< stats.blended << " blended" << std::endl;
+}
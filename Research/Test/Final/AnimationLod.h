@@ -0,0 +1,86 @@
+/*
+  FileName    : AnimationLod.h
+  Author      : Zachary Zuch
+  Description : Animation level of detail. Each animated model's update rate
+  				is picked from how large its bounding sphere projects and
+  				whether any instance passed the last frame's cull, every frame, every
+  				2nd, every 4th or frozen. Skeletons blend between their
+  				cached palettes on the frames they are not evaluated.
+*/
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Camera.h"
+
+class Model;
+
+struct AnimationLodSettings
+{
+	AnimationLodSettings();
+
+	// Projected radius, as a fraction of half the viewport height, at or
+	// 	above which a model updates every frame, and every 2nd frame.
+	// 	Smaller visible models update every 4th frame.
+	float fullSize;
+	float halfSize;
+};
+
+class AnimationLod
+{
+public:
+
+	enum class Level { FULL, HALF, QUARTER, FROZEN, NUM_LEVELS };
+
+	struct Stats
+	{
+		Stats();
+
+		// Skeletons at each level
+		unsigned levels[static_cast<unsigned> (Level::NUM_LEVELS)];
+		// Skeletons whose clip was evaluated and that only blended
+		unsigned evaluated;
+		unsigned blended;
+	};
+
+	explicit AnimationLod(const AnimationLodSettings& settings = AnimationLodSettings());
+
+	// Disable copy ctor and copy assignment
+	AnimationLod (const AnimationLod&) = delete;
+	AnimationLod& operator= (const AnimationLod&) = delete;
+
+	// Level for the instances of model seen by camera. visible holds the
+	// 	instance bits of the last batched cull with model's first instance
+	// 	at first, see BoundsBatch::cull. Size is only projected for visible
+	// 	instances; null treats every instance as visible.
+	Level
+	chooseLevel(Model& model, const Camera& camera,
+		const std::vector<uint64_t>* visible, unsigned first) const;
+
+	// Count a skeleton advanced at level's rate, and whether its clip was
+	// 	evaluated, see Skeleton::update
+	void
+	record(Level level, bool isEvaluated);
+
+	// Frames between evaluations, 0 for never
+	static unsigned
+	period(Level level);
+
+	// Keep the finished frame's counts and start counting the next
+	void
+	beginFrame();
+
+	const Stats&
+	getLastFrameStats() const;
+
+	void
+	printStats(std::ostream& out = std::cout) const;
+
+private:
+
+	AnimationLodSettings m_settings;
+	Stats m_frame;
+	Stats m_lastFrame;
+};
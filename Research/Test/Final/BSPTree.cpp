@@ -1,12 +1,107 @@
-#include <gsl/gsl_eigen.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
 #include "Math.h"
 #include "BSPTree.h"
 #include "Material.h"
 
+namespace
+{
+	// Cache layout, every section follows the previous one unpadded:
+	// 	header, nodes, bounds (6 floats per node), vertex floats,
+	// 	indices, bone weights, bone indices
+	struct BSPCacheHeader
+	{
+		char 		magic[4];
+		uint32_t 	version;
+		uint64_t 	sourceHash;
+		uint32_t 	numNodes;
+		uint32_t 	numVertexFloats;
+		uint32_t 	numIndices;
+		uint32_t 	numBoneValues;
+	};
+	static_assert(sizeof(BSPCacheHeader) == 32, "BSPCacheHeader should stay 32 bytes");
+
+	constexpr char CACHE_MAGIC[4] = { 'B', 'S', 'P', 'C' };
+	constexpr unsigned BOUNDS_PER_NODE = 6;
+
+	// Whether traversal can walk nodes without leaving its fixed stack or
+	// 	reading past indices, and every index names one of numVertices.
+	// 	Children sit after their parent in pre-order, which rules out cycles.
+	bool
+	isValidTree(const BSPFlatNode* nodes, int numNodes, const unsigned* indices, unsigned numIndices, unsigned numVertices)
+	{
+		std::vector<unsigned> depths(numNodes, 0);
+		std::vector<bool> isReached(numNodes, false);
+		for (int i = 0; i < numNodes; ++i)
+		{
+			const BSPFlatNode& node = nodes[i];
+			if (node.front == BSPTree::NO_NODE && node.back == BSPTree::NO_NODE)
+			{
+				if (uint64_t(node.firstIndex) + node.indexCount > numIndices)
+				{
+					return false;
+				}
+				continue;
+			}
+			for (int child : { node.front, node.back })
+			{
+				if (child == BSPTree::NO_NODE)
+				{
+					continue;
+				}
+				if (child <= i || child >= numNodes || isReached[child])
+				{
+					return false;
+				}
+				isReached[child] = true;
+				depths[child] = depths[i] + 1;
+				if (depths[child] > BSPTree::MAX_DEPTH)
+				{
+					return false;
+				}
+			}
+		}
+		for (unsigned i = 0; i < numIndices; ++i)
+		{
+			if (indices[i] >= numVertices)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+SpatialIndexStats::SpatialIndexStats()
+: numNodes(0)
+, numLeaves(0)
+, maxDepth(0)
+, numTriangles(0)
+, maxLeafTriangles(0)
+, sahCost(0)
+{ }
+
+float
+surfaceArea(const float* lrbtnf)
+{
+	float width  = lrbtnf[1] - lrbtnf[0];
+	float height = lrbtnf[3] - lrbtnf[2];
+	float depth  = lrbtnf[5] - lrbtnf[4];
+	if (width < 0 || height < 0 || depth < 0)
+	{
+		return 0;
+	}
+	return 2 * (width * height + height * depth + depth * width);
+}
+
 // init node constructor
-BSPNode::BSPNode(Mesh* polygonList, /*BSPNode* nodeParent,*/ BSPNode* nodeFront, BSPNode* nodeBack)
+BSPNode::BSPNode(Mesh* polygonList, BSPNode* nodeFront, BSPNode* nodeBack)
 : polygons(polygonList)
-// , parent(nodeParent)
 , front(nodeFront)
 , back(nodeBack)
 { }
@@ -33,93 +128,229 @@ void
 BSPNode::calculateSplitter()
 {
 	// Mean/Centroid and Covariance matrix calculations
-	Vector3 centroid = polygons->getMeshCenter();
-	Matrix3 covariance;
-	covariance.setToZero();
-	polygons->getCovarianceMatrix(centroid, covariance);
-
-	// setup for gsl library
-	// gsl is a c function library so pointers 
-	//	must be allocated and destroyed will explicit calls
-	constexpr unsigned MATRIX_ROW_MAX = 3;
-	gsl_eigen_symmv_workspace* w = gsl_eigen_symmv_alloc(MATRIX_ROW_MAX);
-	gsl_matrix* cov = gsl_matrix_calloc(MATRIX_ROW_MAX, MATRIX_ROW_MAX);
-	for (unsigned i = 0; i < MATRIX_ROW_MAX; ++i)
-	{
-		for (unsigned j = 0; j < MATRIX_ROW_MAX; ++j)
-		{
-			gsl_matrix_set(cov, i, j, covariance.getValue(i,j));
-		}
-	}
-	gsl_vector* eval = gsl_vector_calloc(MATRIX_ROW_MAX);
-	gsl_matrix* evec = gsl_matrix_calloc(MATRIX_ROW_MAX, MATRIX_ROW_MAX);
+	Moments moments = polygons->getMoments();
+	Vector3 centroid = moments.mean();
+	Matrix3 covariance = moments.covariance();
 
-	// gsl eigen call for real symmetric matrix which a covariance of primitve positions is
-	gsl_eigen_symmv(cov, eval, evec, w);
-	gsl_matrix_free(cov);
-	gsl_eigen_symmv_free(w);
+	// Largest eigen value will create a normal that points in the direction of the most variance
+	//	which means better subdivison
+	Vector3 eigenValues;
+	Matrix3 eigenVectors;
+	covariance.symmetricEigen(eigenValues, eigenVectors);
+	Vector3 splitNormal = eigenVectors.getRight();
+	splitter = { splitNormal.x, splitNormal.y, splitNormal.z, -( splitNormal.dot( centroid ))};
+}
 
-	std::vector<double> eigenValues =
-	{
-		gsl_vector_get(eval, 0),
-		gsl_vector_get(eval, 1),
-		gsl_vector_get(eval, 2)
-	};
-	gsl_vector_free(eval);
+BSPTree::BSPTree()
+: m_nodeData(nullptr)
+, m_boundData(nullptr)
+, m_numNodes(0)
+, m_nodes()
+, m_bounds()
+, m_cache()
+, m_boxes()
+, m_drawOrder()
+, m_geometry(nullptr)
+{ }
 
-	// largest eigen value will create a normal that points in the direction of the most variance
-	//	which means better subdivison
+BSPTree::BSPTree(Mesh* polygonList)
+: BSPTree()
+{
+	BSPNode* root = new BSPNode(polygonList);
+	buildTree(root, TaskPool::shared(), 0);
+
+	std::vector<float> vertexData;
+	std::vector<unsigned> indices;
+	std::vector<float> boneWeights;
+	std::vector<unsigned> boneIndices;
+	flatten(root, vertexData, indices, boneWeights, boneIndices);
+	delete root;
+	m_nodeData = m_nodes.data();
+	m_boundData = m_bounds.data();
+	m_numNodes = m_nodes.size();
+	m_geometry = new Mesh(std::move(vertexData), std::move(indices), "", std::move(boneWeights), std::move(boneIndices));
 
-	unsigned greatestEigenValue = ( eigenValues[0] > eigenValues[1] ) ? 0 : 1;
-	greatestEigenValue = ( eigenValues[ greatestEigenValue ] > eigenValues[1] ) ? greatestEigenValue : 2;
+	// GL uploads stay on the thread that owns the context
+	prepare();
+	initBoxes();
+}
 
-	Vector3 splitNormal = 
-	{
-		static_cast<float>( gsl_matrix_get( evec, 0, greatestEigenValue )),
-		static_cast<float>( gsl_matrix_get( evec, 1, greatestEigenValue )),
-		static_cast<float>( gsl_matrix_get( evec, 2, greatestEigenValue ))
-	};
-	gsl_matrix_free(evec);
-	splitter = { splitNormal.x, splitNormal.y, splitNormal.z, -( splitNormal.dot( centroid ))};
+BSPTree::~BSPTree()
+{
+	delete m_geometry;
 }
 
-void
-BSPNode::initBox()
+BSPTree*
+BSPTree::loadOrBuild(const std::string& sourceFile, const std::string& cacheFile,
+	const std::function<Mesh*()>& makePolygons)
 {
-	if (polygons == nullptr) return;
+	const uint64_t sourceHash = MappedFile::hashFile(sourceFile);
 
-	std::vector<float> lrbtnf;
-	polygons->getBoxBV(lrbtnf);
-	box.init(lrbtnf);
+	BSPTree* tree = new BSPTree();
+	if (sourceHash != 0 && tree->load(cacheFile, sourceHash))
+	{
+		tree->prepare();
+		tree->initBoxes();
+		return tree;
+	}
+	delete tree;
+
+	tree = new BSPTree(makePolygons());
+	if (sourceHash != 0)
+	{
+		tree->save(cacheFile, sourceHash);
+	}
+	return tree;
 }
 
-BSPTree::BSPTree(Mesh* polygonList)
-: root(new BSPNode(polygonList))
+bool
+BSPTree::save(const std::string& cacheFile, uint64_t sourceHash) const
 {
-	buildTree(root);
-	prepare();
-	initBoxes();
+	const std::vector<float>& vertexData = m_geometry->getVertexData();
+	const std::vector<unsigned>& indices = m_geometry->getIndices();
+	const std::vector<float>& boneWeights = m_geometry->getBoneWeights();
+	const std::vector<unsigned>& boneIndices = m_geometry->getBoneIndices();
+
+	BSPCacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.numNodes = m_numNodes;
+	header.numVertexFloats = vertexData.size();
+	header.numIndices = indices.size();
+	header.numBoneValues = m_geometry->isBoneless() ? 0 : boneWeights.size();
+
+	// Written beside the target and renamed so a crash never leaves half a cache
+	const std::string tempFile = cacheFile + ".tmp";
+	{
+		std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			return false;
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(m_nodeData), m_numNodes * sizeof(BSPFlatNode));
+		out.write(reinterpret_cast<const char*>(m_boundData), m_numNodes * BOUNDS_PER_NODE * sizeof(float));
+		out.write(reinterpret_cast<const char*>(vertexData.data()), vertexData.size() * sizeof(float));
+		out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned));
+		if (header.numBoneValues != 0)
+		{
+			out.write(reinterpret_cast<const char*>(boneWeights.data()), boneWeights.size() * sizeof(float));
+			out.write(reinterpret_cast<const char*>(boneIndices.data()), boneIndices.size() * sizeof(unsigned));
+		}
+		if (!out)
+		{
+			std::remove(tempFile.c_str());
+			return false;
+		}
+	}
+	return std::rename(tempFile.c_str(), cacheFile.c_str()) == 0;
 }
 
-BSPTree::~BSPTree()
+bool
+BSPTree::load(const std::string& cacheFile, uint64_t sourceHash)
 {
-	delete root;
+	MappedFile& file = m_cache;
+	if (!file.open(cacheFile) || file.size() < sizeof(BSPCacheHeader))
+	{
+		return false;
+	}
+
+	BSPCacheHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != CACHE_VERSION
+		|| header.sourceHash != sourceHash
+		|| header.numNodes == 0)
+	{
+		return false;
+	}
+	// Whole vertices, and bone data for every vertex or none
+	const unsigned numVertices = header.numVertexFloats / Mesh::FLOATS_PER_VERTEX;
+	if (header.numVertexFloats % Mesh::FLOATS_PER_VERTEX != 0
+		|| (header.numBoneValues != 0 && header.numBoneValues != uint64_t(numVertices) * Mesh::NUM_BONE_INDICES))
+	{
+		return false;
+	}
+
+	const size_t nodeBytes = size_t(header.numNodes) * sizeof(BSPFlatNode);
+	const size_t boundsBytes = size_t(header.numNodes) * BOUNDS_PER_NODE * sizeof(float);
+	const size_t vertexBytes = size_t(header.numVertexFloats) * sizeof(float);
+	const size_t indexBytes = size_t(header.numIndices) * sizeof(unsigned);
+	const size_t boneBytes = size_t(header.numBoneValues) * (sizeof(float) + sizeof(unsigned));
+	if (file.size() != sizeof(header) + nodeBytes + boundsBytes + vertexBytes + indexBytes + boneBytes)
+	{
+		return false;
+	}
+
+	// Nodes and bounds are read in place, geometry is copied once into the mesh
+	const unsigned char* section = file.data() + sizeof(header);
+	const BSPFlatNode* nodes = reinterpret_cast<const BSPFlatNode*>(section);
+	section += nodeBytes;
+	const float* bounds = reinterpret_cast<const float*>(section);
+	section += boundsBytes;
+	const float* vertices = reinterpret_cast<const float*>(section);
+	section += vertexBytes;
+	const unsigned* indices = reinterpret_cast<const unsigned*>(section);
+	section += indexBytes;
+
+	// A stale but consistent file still has to be safe to traverse
+	if (!isValidTree(nodes, header.numNodes, indices, header.numIndices, numVertices))
+	{
+		return false;
+	}
+	m_nodeData = nodes;
+	m_boundData = bounds;
+	m_numNodes = header.numNodes;
+
+	std::vector<float> boneWeights;
+	std::vector<unsigned> boneIndices;
+	if (header.numBoneValues != 0)
+	{
+		const float* weights = reinterpret_cast<const float*>(section);
+		boneWeights.assign(weights, weights + header.numBoneValues);
+		section += header.numBoneValues * sizeof(float);
+
+		const unsigned* boneIndexSection = reinterpret_cast<const unsigned*>(section);
+		boneIndices.assign(boneIndexSection, boneIndexSection + header.numBoneValues);
+	}
+
+	m_geometry = new Mesh(std::vector<float>(vertices, vertices + header.numVertexFloats),
+		std::vector<unsigned>(indices, indices + header.numIndices), "",
+		std::move(boneWeights), std::move(boneIndices));
+	return true;
 }
 
 void
 BSPTree::prepare()
 {
-	prepare(root);
+	m_geometry->prepareVao();
 }
 
 void
 BSPTree::initBoxes()
 {
-	initBoxes(root);
+	m_boxes.resize(m_numNodes);
+	std::vector<float> lrbtnf(BOUNDS_PER_NODE);
+	for (unsigned i = 0; i < m_numNodes; ++i)
+	{
+		lrbtnf.assign(m_boundData + BOUNDS_PER_NODE * i, m_boundData + BOUNDS_PER_NODE * (i + 1));
+		// Empty leaves keep inverted limits and a default box
+		if (lrbtnf[0] <= lrbtnf[1])
+		{
+			m_boxes[i].init(lrbtnf);
+		}
+	}
+}
+
+unsigned
+BSPTree::numNodes() const
+{
+	return m_numNodes;
 }
 
 void
-BSPTree::buildTree(BSPNode* node)
+BSPTree::buildTree(BSPNode* node, TaskPool& pool, unsigned depth)
 {
 	if (node == nullptr)
 	{
@@ -128,14 +359,14 @@ BSPTree::buildTree(BSPNode* node)
 
 	constexpr unsigned INDICES_PER_TRIANGLE = 3;
 	constexpr unsigned MAX_POLYGONS_PER_NODE = 600;
+	// Below this a subtree is cheaper to finish than to hand to another worker
+	constexpr unsigned MIN_POLYGONS_TO_FORK = 20000;
 	unsigned numPolygons = node->polygons->numIndices() / INDICES_PER_TRIANGLE;
-	if (numPolygons <= MAX_POLYGONS_PER_NODE)
+	if (numPolygons <= MAX_POLYGONS_PER_NODE || depth >= MAX_DEPTH)
 	{
 		return;
 	}
 
-	std::cout << "SPLIT" << std::endl;
-
 	node->calculateSplitter();
 	std::pair<Mesh*, Mesh*> splitMeshes = node->polygons->split(node->splitter);
 
@@ -143,93 +374,212 @@ BSPTree::buildTree(BSPNode* node)
 	node->polygons = nullptr;
 
 	node->front = new BSPNode(splitMeshes.first);
-	buildTree(node->front);
-
 	node->back = new BSPNode(splitMeshes.second);
-	buildTree(node->back);
-}
 
-bool
-BSPTree::isFront(const Vector3& position, BSPNode* node)
-{
-	if (node->splitter.dist(position) >= 0)
+	// Each subtree only touches its own nodes and meshes
+	if (numPolygons >= MIN_POLYGONS_TO_FORK)
 	{
-		return true;
+		TaskGroup group;
+		pool.submit(group, [this, node, &pool, depth]() { buildTree(node->front, pool, depth + 1); });
+		buildTree(node->back, pool, depth + 1);
+		pool.wait(group);
+	}
+	else
+	{
+		buildTree(node->front, pool, depth + 1);
+		buildTree(node->back, pool, depth + 1);
 	}
-	return false;
 }
 
-void
-BSPTree::draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD)
+int
+BSPTree::flatten(BSPNode* node, std::vector<float>& vertexData, std::vector<unsigned>& indices,
+	std::vector<float>& boneWeights, std::vector<unsigned>& boneIndices)
 {
-	draw(shaderProgram, camera, modelView, sphereD, root);
-}
+	if (node == nullptr)
+	{
+		return NO_NODE;
+	}
 
-void
-BSPTree::draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD, BSPNode* node)
-{
-	if (node == nullptr) return;
+	// Pre-order so the front child sits right after its parent
+	const int index = m_nodes.size();
+	m_nodes.push_back({ { 0, 0, 0, 0 }, NO_NODE, NO_NODE, 0, 0 });
+	m_bounds.insert(m_bounds.end(), { FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX });
+	float* bounds = &m_bounds[BOUNDS_PER_NODE * index];
 
-	if (isFront(camera.getPosition(), node))
+	if (node->polygons != nullptr)
 	{
-		draw(shaderProgram, camera, modelView, sphereD, node->back);
-		
-		if (node->polygons != nullptr)
+		Mesh& leaf = *node->polygons;
+		const unsigned baseVertex = vertexData.size() / Mesh::FLOATS_PER_VERTEX;
+		m_nodes[index].firstIndex = indices.size();
+		m_nodes[index].indexCount = leaf.numIndices();
+		if (leaf.numIndices() != 0)
 		{
-			node->polygons->draw();
-			sphereD.init(node->box);
-			sphereD.draw(shaderProgram, modelView);
+			std::vector<float> lrbtnf;
+			leaf.getBoxBV(lrbtnf);
+			std::copy(lrbtnf.begin(), lrbtnf.end(), bounds);
 		}
 
-		draw(shaderProgram, camera, modelView, sphereD, node->front);
+		for (unsigned vertexIndex : leaf.getIndices())
+		{
+			indices.push_back(baseVertex + vertexIndex);
+		}
+		vertexData.insert(vertexData.end(), leaf.getVertexData().begin(), leaf.getVertexData().end());
+		boneWeights.insert(boneWeights.end(), leaf.getBoneWeights().begin(), leaf.getBoneWeights().end());
+		boneIndices.insert(boneIndices.end(), leaf.getBoneIndices().begin(), leaf.getBoneIndices().end());
+		return index;
 	}
-	else
-	{
-		draw(shaderProgram, camera, modelView, sphereD, node->front);
 
-		if (node->polygons != nullptr)
+	const Plane& splitter = node->splitter;
+	std::copy(splitter.normal.data(), splitter.normal.data() + 3, m_nodes[index].plane);
+	m_nodes[index].plane[3] = splitter.d;
+
+	// m_nodes and m_bounds grow while recursing so only hold indices
+	const int front = flatten(node->front, vertexData, indices, boneWeights, boneIndices);
+	const int back  = flatten(node->back,  vertexData, indices, boneWeights, boneIndices);
+	m_nodes[index].front = front;
+	m_nodes[index].back  = back;
+
+	bounds = &m_bounds[BOUNDS_PER_NODE * index];
+	for (int child : { front, back })
+	{
+		if (child == NO_NODE) continue;
+		const float* childBounds = &m_bounds[BOUNDS_PER_NODE * child];
+		for (unsigned axis = 0; axis < BOUNDS_PER_NODE; axis += 2)
 		{
-			node->polygons->draw();
-			sphereD.init(node->box);
-			sphereD.draw(shaderProgram, modelView);
+			bounds[axis]     = std::min(bounds[axis],     childBounds[axis]);
+			bounds[axis + 1] = std::max(bounds[axis + 1], childBounds[axis + 1]);
 		}
-
-		draw(shaderProgram, camera, modelView, sphereD, node->back);
 	}
+	return index;
 }
 
-void
-BSPTree::initBoxes(BSPNode* node)
+bool
+BSPTree::isFront(const Vector3& position, const BSPFlatNode& node) const
 {
-	if (node == nullptr) return;
+	return node.plane[0] * position.x + node.plane[1] * position.y + node.plane[2] * position.z + node.plane[3] >= 0;
+}
 
-	node->initBox();
+void
+BSPTree::traverse(const Vector3& eye, BSPOrder order, std::vector<unsigned>& leaves) const
+{
+	leaves.clear();
+	if (m_numNodes == 0) return;
+
+	// Depth is capped at MAX_DEPTH and each level pushes at most one sibling
+	int stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top != 0)
+	{
+		const int index = stack[--top];
+		const BSPFlatNode& node = m_nodeData[index];
+		if (node.front == NO_NODE && node.back == NO_NODE)
+		{
+			leaves.push_back(index);
+			continue;
+		}
 
-	initBoxes(node->front);
+		// The side the eye is on is the near side
+		bool nearIsFront = isFront(eye, node);
+		int nearChild = nearIsFront ? node.front : node.back;
+		int farChild  = nearIsFront ? node.back  : node.front;
+		if (order == BSPOrder::BACK_TO_FRONT)
+		{
+			std::swap(nearChild, farChild);
+		}
 
-	initBoxes(node->back);
+		// Pushed last so it is visited first
+		if (farChild  != NO_NODE) stack[top++] = farChild;
+		if (nearChild != NO_NODE) stack[top++] = nearChild;
+	}
 }
 
 void
-BSPTree::prepare(BSPNode* node)
+BSPTree::draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD,
+	BSPOrder order)
 {
-	if (node == nullptr)
+	traverse(camera.getPosition(), order, m_drawOrder);
+	for (unsigned index : m_drawOrder)
 	{
-		return;
-	}
+		const BSPFlatNode& leaf = m_nodeData[index];
+		if (leaf.indexCount == 0) continue;
 
-	if (node->polygons != nullptr)
-	{
-		node->polygons->prepareVao();
+		m_geometry->draw(leaf.firstIndex, leaf.indexCount);
+		sphereD.init(m_boxes[index]);
+		sphereD.draw(shaderProgram, modelView);
 	}
+}
 
-	if (node->front != nullptr)
+void
+BSPTree::cull(Frustum& frustum, std::vector<unsigned>& leaves)
+{
+	leaves.clear();
+	if (m_numNodes == 0) return;
+
+	int stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top != 0)
 	{
-		prepare(node->front);
+		const int index = stack[--top];
+		const BSPFlatNode& node = m_nodeData[index];
+		const bool isLeaf = node.front == NO_NODE && node.back == NO_NODE;
+		if ((isLeaf && node.indexCount == 0) || !frustum.inFrustum(m_boxes[index]))
+		{
+			continue;
+		}
+
+		if (isLeaf)
+		{
+			leaves.push_back(index);
+			continue;
+		}
+		if (node.back  != NO_NODE) stack[top++] = node.back;
+		if (node.front != NO_NODE) stack[top++] = node.front;
 	}
+}
+
+unsigned
+BSPTree::leafTriangles(unsigned leaf) const
+{
+	constexpr unsigned INDICES_PER_TRIANGLE = 3;
+	return m_nodeData[leaf].indexCount / INDICES_PER_TRIANGLE;
+}
 
-	if (node->back != nullptr)
+SpatialIndexStats
+BSPTree::stats() const
+{
+	SpatialIndexStats result;
+	if (m_numNodes == 0) return result;
+
+	const float rootArea = surfaceArea(m_boundData);
+	std::pair<int, unsigned> stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = { 0, 0 };
+	while (top != 0)
 	{
-		prepare(node->back);
+		const int index = stack[top - 1].first;
+		const unsigned depth = stack[top - 1].second;
+		--top;
+
+		const BSPFlatNode& node = m_nodeData[index];
+		const float areaRatio = (rootArea > 0) ? surfaceArea(&m_boundData[BOUNDS_PER_NODE * index]) / rootArea : 1;
+		++result.numNodes;
+		result.maxDepth = std::max(result.maxDepth, depth);
+
+		if (node.front == NO_NODE && node.back == NO_NODE)
+		{
+			const unsigned triangles = leafTriangles(index);
+			++result.numLeaves;
+			result.numTriangles += triangles;
+			result.maxLeafTriangles = std::max(result.maxLeafTriangles, triangles);
+			result.sahCost += areaRatio * triangles;
+			continue;
+		}
+
+		result.sahCost += areaRatio * SpatialIndexStats::TRAVERSAL_COST;
+		if (node.back  != NO_NODE) stack[top++] = { node.back,  depth + 1 };
+		if (node.front != NO_NODE) stack[top++] = { node.front, depth + 1 };
 	}
-}
\ No newline at end of file
+	return result;
+}
@@ -1,44 +1,97 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <string>
+
 #include "Frustum.h"
+#include "MappedFile.h"
 #include "Mesh.h"
 #include "Camera.h"
 #include "Debug.h"
-#include <gsl/gsl_eigen.h>
+#include "TaskPool.h"
 
+// Pointer linked node only used while the tree is being built
 struct BSPNode
 {
 	Plane 		splitter;
 	Mesh* 		polygons;
-	// parent added for iterative traversal
-	// will be added later
-	// BSPNode* 	parent;
 	BSPNode* 	front;
 	BSPNode* 	back;
-	BoxBV 		box;
 
 	// init node constructor
-	BSPNode(Mesh* polygonList = nullptr, /*BSPNode* nodeParent = nullptr,*/ BSPNode* nodeFront = nullptr, BSPNode* nodeBack = nullptr);
+	BSPNode(Mesh* polygonList = nullptr, BSPNode* nodeFront = nullptr, BSPNode* nodeBack = nullptr);
 
 	~BSPNode();
 
 	void
 	calculateSplitter();
+};
 
-	void
-	initBox();
+// Node of the flattened tree. Two fit in a cache line, children are
+// 	indices into the same array and leaves own a range of the index buffer.
+struct BSPFlatNode
+{
+	float 		plane[4];
+	int 		front;
+	int 		back;
+	unsigned 	firstIndex;
+	unsigned 	indexCount;
+};
+static_assert(sizeof(BSPFlatNode) == 32, "BSPFlatNode should stay 32 bytes");
+
+// Build quality of a spatial index
+struct SpatialIndexStats
+{
+	SpatialIndexStats();
+
+	unsigned numNodes;
+	unsigned numLeaves;
+	unsigned maxDepth;
+	unsigned numTriangles;
+	unsigned maxLeafTriangles;
+	// Surface area heuristic: TRAVERSAL_COST per interior node plus one per
+	// 	triangle, each weighted by its box area over the root's
+	float sahCost;
+
+	// A node visit priced in triangles, a culled node costs roughly a draw call
+	static constexpr float TRAVERSAL_COST = 32.0f;
+};
+
+// Surface area of an lrbtnf box, 0 if it is empty
+float
+surfaceArea(const float* lrbtnf);
+
+enum class BSPOrder
+{
+	FRONT_TO_BACK, BACK_TO_FRONT
 };
 
 class BSPTree
 {
 public:
-	
+
 	BSPTree(Mesh* polygonList);
 
 	~BSPTree();
 
+	// Disable default copy ctor and copy assignment
+	BSPTree (const BSPTree&) = delete;
+	BSPTree& operator= (const BSPTree&) = delete;
+
+	// Maps cacheFile if it was saved from the current contents of sourceFile,
+	// 	otherwise builds from makePolygons() and rewrites the cache
+	static BSPTree*
+	loadOrBuild(const std::string& sourceFile, const std::string& cacheFile,
+		const std::function<Mesh*()>& makePolygons);
+
+	// Write the flattened nodes, bounds and merged geometry to cacheFile
+	bool
+	save(const std::string& cacheFile, uint64_t sourceHash) const;
+
 	void
-	draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD);
+	draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD,
+		BSPOrder order = BSPOrder::BACK_TO_FRONT);
 
 	void
 	prepare();
@@ -46,22 +99,61 @@ public:
 	void
 	initBoxes();
 
-private:
+	// Leaf node indices sorted by distance from eye
+	void
+	traverse(const Vector3& eye, BSPOrder order, std::vector<unsigned>& leaves) const;
 
+	// Non empty leaves whose box is in the frustum, skipping culled subtrees
 	void
-	buildTree(BSPNode* node);
+	cull(Frustum& frustum, std::vector<unsigned>& leaves);
 
-	bool
-	isFront(const Vector3& position, BSPNode* node);
+	unsigned
+	leafTriangles(unsigned leaf) const;
 
-	void
-	draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD, BSPNode* node);
+	SpatialIndexStats
+	stats() const;
 
-	void
-	prepare(BSPNode* node);
+	unsigned
+	numNodes() const;
+
+	static constexpr int NO_NODE = -1;
+	// Leaves are not split past this depth so traversal can use a fixed stack
+	static constexpr unsigned MAX_DEPTH = 63;
+
+	// Bump whenever the cache layout or the build parameters change
+	static constexpr uint32_t CACHE_VERSION = 1;
+
+private:
+
+	// Empty tree filled in by load
+	BSPTree();
+
+	// Keeps cacheFile mapped, false leaves the tree unusable
+	bool
+	load(const std::string& cacheFile, uint64_t sourceHash);
 
 	void
-	initBoxes(BSPNode* node);
+	buildTree(BSPNode* node, TaskPool& pool, unsigned depth);
 
-	BSPNode* root;
-};
\ No newline at end of file
+	// Copy the built tree into m_nodes, returning the index of node
+	int
+	flatten(BSPNode* node, std::vector<float>& vertexData, std::vector<unsigned>& indices,
+		std::vector<float>& boneWeights, std::vector<unsigned>& boneIndices);
+
+	bool
+	isFront(const Vector3& position, const BSPFlatNode& node) const;
+
+	// Nodes and their lrbtnf bounds, kept apart for traversal. They point
+	// 	into m_nodes and m_bounds for a built tree and into m_cache for a
+	// 	loaded one.
+	const BSPFlatNode* m_nodeData;
+	const float* m_boundData;
+	unsigned m_numNodes;
+	std::vector<BSPFlatNode> m_nodes;
+	std::vector<float> m_bounds;
+	MappedFile m_cache;
+	std::vector<BoxBV> m_boxes;
+	std::vector<unsigned> m_drawOrder;
+	// Geometry of every leaf in one vertex and index buffer
+	Mesh* m_geometry;
+};
@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <iomanip>
+
+#include "BVHTree.h"
+
+namespace
+{
+	constexpr unsigned INDICES_PER_TRIANGLE = 3;
+
+	struct Bounds
+	{
+		float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void
+		grow(const float* otherMin, const float* otherMax)
+		{
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], otherMin[axis]);
+				max[axis] = std::max(max[axis], otherMax[axis]);
+			}
+		}
+
+		float
+		area() const
+		{
+			const float lrbtnf[6] = { min[0], max[0], min[1], max[1], min[2], max[2] };
+			return surfaceArea(lrbtnf);
+		}
+	};
+
+	float
+	nodeArea(const BVHFlatNode& node)
+	{
+		const float lrbtnf[6] = { node.min[0], node.max[0], node.min[1], node.max[1], node.min[2], node.max[2] };
+		return surfaceArea(lrbtnf);
+	}
+}
+
+struct BVHTree::BuildState
+{
+	// Per triangle box and centroid
+	std::vector<float> 		triangleMin;
+	std::vector<float> 		triangleMax;
+	std::vector<float> 		centroids;
+	// Triangles are sorted in place so every node owns a contiguous range
+	std::vector<unsigned> 	order;
+	std::atomic<unsigned> 	nextNode;
+	TaskPool* 				pool;
+};
+
+BVHBuildSettings::BVHBuildSettings()
+: numBins(16)
+, minLeafTriangles(64)
+, maxLeafTriangles(1024)
+, minTrianglesToFork(20000)
+, traversalCost(SpatialIndexStats::TRAVERSAL_COST)
+{ }
+
+BVHTree::BVHTree(Mesh* polygonList, const BVHBuildSettings& settings)
+: m_nodes()
+, m_boxes()
+, m_drawOrder()
+, m_geometry(nullptr)
+, m_settings(settings)
+{
+	// Compared rather than passed to std::min, which would odr-use MAX_BINS
+	if (m_settings.numBins > BVHBuildSettings::MAX_BINS) m_settings.numBins = BVHBuildSettings::MAX_BINS;
+	if (m_settings.numBins < 2) m_settings.numBins = 2;
+
+	const std::vector<float>& vertexData = polygonList->getVertexData();
+	const std::vector<unsigned>& indices = polygonList->getIndices();
+	const unsigned numTriangles = indices.size() / INDICES_PER_TRIANGLE;
+
+	BuildState state;
+	state.triangleMin.resize(3 * numTriangles);
+	state.triangleMax.resize(3 * numTriangles);
+	state.centroids.resize(3 * numTriangles);
+	state.order.resize(numTriangles);
+	state.nextNode = 1;
+	state.pool = &TaskPool::shared();
+
+	for (unsigned triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		state.order[triangle] = triangle;
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			float low = FLT_MAX, high = -FLT_MAX;
+			for (unsigned corner = 0; corner < INDICES_PER_TRIANGLE; ++corner)
+			{
+				unsigned vertex = indices[ INDICES_PER_TRIANGLE * triangle + corner ];
+				float value = vertexData[ Mesh::FLOATS_PER_VERTEX * vertex + axis ];
+				low  = std::min(low, value);
+				high = std::max(high, value);
+			}
+			state.triangleMin[ 3 * triangle + axis ] = low;
+			state.triangleMax[ 3 * triangle + axis ] = high;
+			state.centroids  [ 3 * triangle + axis ] = 0.5f * (low + high);
+		}
+	}
+
+	// A binary tree over n leaves never needs more than 2n - 1 nodes
+	if (numTriangles != 0)
+	{
+		m_nodes.resize(2 * numTriangles - 1);
+		buildNode(state, 0, 0, numTriangles, 0);
+		m_nodes.resize(state.nextNode);
+	}
+
+	std::vector<unsigned> sortedIndices;
+	sortedIndices.reserve(indices.size());
+	for (unsigned triangle : state.order)
+	{
+		sortedIndices.insert(sortedIndices.end(), indices.begin() + INDICES_PER_TRIANGLE * triangle,
+			indices.begin() + INDICES_PER_TRIANGLE * (triangle + 1));
+	}
+	m_geometry = new Mesh(vertexData, sortedIndices, polygonList->textureFilePath,
+		polygonList->getBoneWeights(), polygonList->getBoneIndices());
+	delete polygonList;
+
+	// GL uploads stay on the thread that owns the context
+	prepare();
+	initBoxes();
+}
+
+BVHTree::~BVHTree()
+{
+	delete m_geometry;
+}
+
+void
+BVHTree::buildNode(BuildState& state, unsigned nodeIndex, unsigned begin, unsigned end, unsigned depth)
+{
+	Bounds bounds, centroidBounds;
+	for (unsigned i = begin; i < end; ++i)
+	{
+		const unsigned triangle = state.order[i];
+		bounds.grow(&state.triangleMin[3 * triangle], &state.triangleMax[3 * triangle]);
+		centroidBounds.grow(&state.centroids[3 * triangle], &state.centroids[3 * triangle]);
+	}
+
+	BVHFlatNode& node = m_nodes[nodeIndex];
+	std::copy(bounds.min, bounds.min + 3, node.min);
+	std::copy(bounds.max, bounds.max + 3, node.max);
+
+	const unsigned count = end - begin;
+	auto makeLeaf = [&]()
+	{
+		node.first = INDICES_PER_TRIANGLE * begin;
+		node.triangleCount = count;
+	};
+
+	if (count <= m_settings.minLeafTriangles || count < 2 || depth >= MAX_DEPTH)
+	{
+		makeLeaf();
+		return;
+	}
+
+	// Bin along the axis the centroids spread furthest on
+	unsigned axis = 0;
+	float extent = centroidBounds.max[0] - centroidBounds.min[0];
+	for (unsigned other = 1; other < 3; ++other)
+	{
+		float otherExtent = centroidBounds.max[other] - centroidBounds.min[other];
+		if (otherExtent > extent)
+		{
+			axis = other;
+			extent = otherExtent;
+		}
+	}
+
+	unsigned middle = begin;
+	if (extent > 0)
+	{
+		const unsigned numBins = m_settings.numBins;
+		const float binScale = numBins / extent;
+		const float axisMin = centroidBounds.min[axis];
+		auto binOf = [&](unsigned triangle)
+		{
+			unsigned bin = static_cast<unsigned>((state.centroids[3 * triangle + axis] - axisMin) * binScale);
+			return std::min(bin, numBins - 1);
+		};
+
+		Bounds binBounds[BVHBuildSettings::MAX_BINS];
+		unsigned binCounts[BVHBuildSettings::MAX_BINS] = { };
+		for (unsigned i = begin; i < end; ++i)
+		{
+			const unsigned triangle = state.order[i];
+			const unsigned bin = binOf(triangle);
+			binBounds[bin].grow(&state.triangleMin[3 * triangle], &state.triangleMax[3 * triangle]);
+			++binCounts[bin];
+		}
+
+		// Sweep from the right to get the cost of everything past each plane
+		float rightAreas[BVHBuildSettings::MAX_BINS];
+		unsigned rightCounts[BVHBuildSettings::MAX_BINS];
+		Bounds right;
+		unsigned rightCount = 0;
+		for (unsigned bin = numBins - 1; bin > 0; --bin)
+		{
+			right.grow(binBounds[bin].min, binBounds[bin].max);
+			rightCount += binCounts[bin];
+			rightAreas[bin] = rightCount ? right.area() : 0;
+			rightCounts[bin] = rightCount;
+		}
+
+		// Plane i splits bins [0, i) from [i, numBins)
+		float bestCost = FLT_MAX;
+		unsigned bestPlane = 0;
+		Bounds left;
+		unsigned leftCount = 0;
+		for (unsigned plane = 1; plane < numBins; ++plane)
+		{
+			left.grow(binBounds[plane - 1].min, binBounds[plane - 1].max);
+			leftCount += binCounts[plane - 1];
+			if (leftCount == 0 || rightCounts[plane] == 0) continue;
+
+			float cost = left.area() * leftCount + rightAreas[plane] * rightCounts[plane];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestPlane = plane;
+			}
+		}
+
+		const float parentArea = bounds.area();
+		const float splitCost = m_settings.traversalCost
+			+ ((parentArea > 0) ? bestCost / parentArea : static_cast<float>(count));
+		if (bestPlane != 0 && (splitCost < count || count > m_settings.maxLeafTriangles))
+		{
+			middle = std::partition(state.order.begin() + begin, state.order.begin() + end,
+				[&](unsigned triangle) { return binOf(triangle) < bestPlane; }) - state.order.begin();
+		}
+		else if (count <= m_settings.maxLeafTriangles)
+		{
+			makeLeaf();
+			return;
+		}
+	}
+	else if (count <= m_settings.maxLeafTriangles)
+	{
+		makeLeaf();
+		return;
+	}
+
+	// Coincident centroids or an empty side, fall back to an even split
+	if (middle == begin || middle == end)
+	{
+		middle = begin + count / 2;
+		std::nth_element(state.order.begin() + begin, state.order.begin() + middle, state.order.begin() + end,
+			[&](unsigned a, unsigned b) { return state.centroids[3 * a + axis] < state.centroids[3 * b + axis]; });
+	}
+
+	const unsigned left = state.nextNode.fetch_add(2);
+	node.first = left;
+	node.triangleCount = 0;
+
+	// Children only touch their own ranges of order and their own nodes
+	if (count >= m_settings.minTrianglesToFork)
+	{
+		TaskGroup group;
+		state.pool->submit(group, [this, &state, left, begin, middle, depth]()
+		{
+			buildNode(state, left, begin, middle, depth + 1);
+		});
+		buildNode(state, left + 1, middle, end, depth + 1);
+		state.pool->wait(group);
+	}
+	else
+	{
+		buildNode(state, left, begin, middle, depth + 1);
+		buildNode(state, left + 1, middle, end, depth + 1);
+	}
+}
+
+void
+BVHTree::prepare()
+{
+	m_geometry->prepareVao();
+}
+
+void
+BVHTree::initBoxes()
+{
+	m_boxes.resize(m_nodes.size());
+	std::vector<float> lrbtnf(6);
+	for (unsigned i = 0; i < m_nodes.size(); ++i)
+	{
+		const BVHFlatNode& node = m_nodes[i];
+		lrbtnf = { node.min[0], node.max[0], node.min[1], node.max[1], node.min[2], node.max[2] };
+		m_boxes[i].init(lrbtnf);
+	}
+}
+
+unsigned
+BVHTree::numNodes() const
+{
+	return m_nodes.size();
+}
+
+unsigned
+BVHTree::leafTriangles(unsigned leaf) const
+{
+	return m_nodes[leaf].triangleCount;
+}
+
+void
+BVHTree::traverse(const Vector3& eye, std::vector<unsigned>& leaves) const
+{
+	leaves.clear();
+	if (m_nodes.empty()) return;
+
+	auto distanceSquared = [&eye](const BVHFlatNode& node)
+	{
+		float dx = 0.5f * (node.min[0] + node.max[0]) - eye.x;
+		float dy = 0.5f * (node.min[1] + node.max[1]) - eye.y;
+		float dz = 0.5f * (node.min[2] + node.max[2]) - eye.z;
+		return dx * dx + dy * dy + dz * dz;
+	};
+
+	unsigned stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top != 0)
+	{
+		const unsigned index = stack[--top];
+		const BVHFlatNode& node = m_nodes[index];
+		if (node.triangleCount != 0)
+		{
+			leaves.push_back(index);
+			continue;
+		}
+
+		unsigned nearChild = node.first;
+		unsigned farChild = node.first + 1;
+		if (distanceSquared(m_nodes[farChild]) < distanceSquared(m_nodes[nearChild]))
+		{
+			std::swap(nearChild, farChild);
+		}
+		// Pushed last so it is visited first
+		stack[top++] = farChild;
+		stack[top++] = nearChild;
+	}
+}
+
+void
+BVHTree::cull(Frustum& frustum, std::vector<unsigned>& leaves)
+{
+	leaves.clear();
+	if (m_nodes.empty()) return;
+
+	unsigned stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top != 0)
+	{
+		const unsigned index = stack[--top];
+		const BVHFlatNode& node = m_nodes[index];
+		if (!frustum.inFrustum(m_boxes[index])) continue;
+
+		if (node.triangleCount != 0)
+		{
+			leaves.push_back(index);
+			continue;
+		}
+		stack[top++] = node.first + 1;
+		stack[top++] = node.first;
+	}
+}
+
+void
+BVHTree::draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD)
+{
+	traverse(camera.getPosition(), m_drawOrder);
+	for (unsigned index : m_drawOrder)
+	{
+		const BVHFlatNode& leaf = m_nodes[index];
+		m_geometry->draw(leaf.first, INDICES_PER_TRIANGLE * leaf.triangleCount);
+		sphereD.init(m_boxes[index]);
+		sphereD.draw(shaderProgram, modelView);
+	}
+}
+
+SpatialIndexStats
+BVHTree::stats() const
+{
+	SpatialIndexStats result;
+	if (m_nodes.empty()) return result;
+
+	const float rootArea = nodeArea(m_nodes[0]);
+
+	std::pair<unsigned, unsigned> stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = { 0, 0 };
+	while (top != 0)
+	{
+		const unsigned index = stack[top - 1].first;
+		const unsigned depth = stack[top - 1].second;
+		--top;
+
+		const BVHFlatNode& node = m_nodes[index];
+		const float areaRatio = (rootArea > 0) ? nodeArea(node) / rootArea : 1;
+		++result.numNodes;
+		result.maxDepth = std::max(result.maxDepth, depth);
+
+		if (node.triangleCount != 0)
+		{
+			++result.numLeaves;
+			result.numTriangles += node.triangleCount;
+			result.maxLeafTriangles = std::max(result.maxLeafTriangles, node.triangleCount);
+			result.sahCost += areaRatio * node.triangleCount;
+			continue;
+		}
+
+		result.sahCost += areaRatio * SpatialIndexStats::TRAVERSAL_COST;
+		stack[top++] = { node.first + 1, depth + 1 };
+		stack[top++] = { node.first,     depth + 1 };
+	}
+	return result;
+}
+
+namespace
+{
+	void
+	printStats(const std::string& name, const SpatialIndexStats& stats, std::ostream& out)
+	{
+		out << std::setw(6) << name
+			<< "  nodes "     << std::setw(7) << stats.numNodes
+			<< "  leaves "    << std::setw(7) << stats.numLeaves
+			<< "  depth "     << std::setw(3) << stats.maxDepth
+			<< "  triangles " << std::setw(9) << stats.numTriangles
+			<< "  max leaf "  << std::setw(6) << stats.maxLeafTriangles
+			<< "  SAH cost "  << std::setw(10) << stats.sahCost << std::endl;
+	}
+}
+
+void
+printBuildQuality(BVHTree& bvh, BSPTree& bsp, const std::vector<Matrix4>& sampleViewProjections,
+	std::ostream& out)
+{
+	std::ios_base::fmtflags origState = out.flags();
+	out << std::fixed << std::setprecision(2);
+
+	const SpatialIndexStats bvhStats = bvh.stats();
+	const SpatialIndexStats bspStats = bsp.stats();
+	out << "Build quality (lower SAH cost is better)" << std::endl;
+	printStats("BVH", bvhStats, out);
+	printStats("BSP", bspStats, out);
+
+	if (!sampleViewProjections.empty())
+	{
+		// Fraction of each tree's triangles still drawn after culling
+		double bvhTriangles = 0, bspTriangles = 0;
+		double bvhLeaves = 0, bspLeaves = 0;
+		std::vector<unsigned> leaves;
+		for (const Matrix4& viewProjection : sampleViewProjections)
+		{
+			Frustum frustum(viewProjection);
+
+			bvh.cull(frustum, leaves);
+			bvhLeaves += leaves.size();
+			for (unsigned leaf : leaves) bvhTriangles += bvh.leafTriangles(leaf);
+
+			bsp.cull(frustum, leaves);
+			bspLeaves += leaves.size();
+			for (unsigned leaf : leaves) bspTriangles += bsp.leafTriangles(leaf);
+		}
+
+		const double views = sampleViewProjections.size();
+		out << "Culling over " << sampleViewProjections.size() << " views (fraction of triangles drawn, leaves drawn)" << std::endl;
+		out << std::setw(6) << "BVH" << "  " << std::setw(6)
+			<< (bvhStats.numTriangles ? bvhTriangles / views / bvhStats.numTriangles : 0)
+			<< "  " << std::setw(9) << bvhLeaves / views << std::endl;
+		out << std::setw(6) << "BSP" << "  " << std::setw(6)
+			<< (bspStats.numTriangles ? bspTriangles / views / bspStats.numTriangles : 0)
+			<< "  " << std::setw(9) << bspLeaves / views << std::endl;
+	}
+	out.flags(origState);
+}
@@ -0,0 +1,105 @@
+/*
+  FileName    : BVHTree.h
+  Author      : Zachary Zuch
+  Description : Bounding volume hierarchy over the triangles of a mesh.
+  				Splits are chosen with a binned surface area heuristic instead
+  				of the BSP's covariance plane, triangles are never clipped and
+  				leaves are ranges of one reordered index buffer.
+*/
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include "BSPTree.h"
+
+// Two nodes per cache line. Interior nodes have triangleCount 0 and first is
+// 	the left child with the right child right after it. Leaves keep their
+// 	first index in the index buffer. An empty mesh gives an empty tree.
+struct BVHFlatNode
+{
+	float 		min[3];
+	unsigned 	first;
+	float 		max[3];
+	unsigned 	triangleCount;
+};
+static_assert(sizeof(BVHFlatNode) == 32, "BVHFlatNode should stay 32 bytes");
+
+struct BVHBuildSettings
+{
+	BVHBuildSettings();
+
+	// Centroid bins per split, at most MAX_BINS
+	unsigned numBins;
+	// Leaves are never split below this
+	unsigned minLeafTriangles;
+	// Leaves are always split above this even if SAH prefers a leaf
+	unsigned maxLeafTriangles;
+	// Subtrees with at least this many triangles are forked onto the pool
+	unsigned minTrianglesToFork;
+	float traversalCost;
+
+	static constexpr unsigned MAX_BINS = 32;
+};
+
+class BVHTree
+{
+public:
+
+	// Takes ownership of polygonList
+	BVHTree(Mesh* polygonList, const BVHBuildSettings& settings = BVHBuildSettings());
+
+	~BVHTree();
+
+	// Disable default copy ctor and copy assignment
+	BVHTree (const BVHTree&) = delete;
+	BVHTree& operator= (const BVHTree&) = delete;
+
+	// Draws leaves nearest first
+	void
+	draw(ShaderProgram* shaderProgram, const Camera& camera, Transform& modelView, SphereDebug& sphereD);
+
+	void
+	prepare();
+
+	void
+	initBoxes();
+
+	// Leaf node indices, the nearer child of every node is visited first
+	void
+	traverse(const Vector3& eye, std::vector<unsigned>& leaves) const;
+
+	// Non empty leaves whose box is in the frustum, skipping culled subtrees
+	void
+	cull(Frustum& frustum, std::vector<unsigned>& leaves);
+
+	unsigned
+	leafTriangles(unsigned leaf) const;
+
+	SpatialIndexStats
+	stats() const;
+
+	unsigned
+	numNodes() const;
+
+	static constexpr unsigned MAX_DEPTH = 63;
+
+private:
+
+	struct BuildState;
+
+	void
+	buildNode(BuildState& state, unsigned nodeIndex, unsigned begin, unsigned end, unsigned depth);
+
+	std::vector<BVHFlatNode> m_nodes;
+	std::vector<BoxBV> m_boxes;
+	std::vector<unsigned> m_drawOrder;
+	Mesh* m_geometry;
+	BVHBuildSettings m_settings;
+};
+
+// Prints SAH cost and shape of both trees, then how many triangles and
+// 	leaves survive frustum culling from each sample view projection
+void
+printBuildQuality(BVHTree& bvh, BSPTree& bsp, const std::vector<Matrix4>& sampleViewProjections,
+	std::ostream& out = std::cout);
@@ -0,0 +1,182 @@
+#include <cmath>
+
+#include "BoundsBatch.h"
+#include "Simd.h"
+
+BoundsBatch::BoundsBatch()
+: centerX(), centerY(), centerZ()
+, extentX(), extentY(), extentZ()
+, axes()
+, isOriented(false)
+{ }
+
+void
+BoundsBatch::clear()
+{
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+	for (std::vector<float>& axis : axes)
+	{
+		axis.clear();
+	}
+	isOriented = false;
+}
+
+void
+BoundsBatch::reserve(unsigned count)
+{
+	centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+	extentX.reserve(count); extentY.reserve(count); extentZ.reserve(count);
+}
+
+unsigned
+BoundsBatch::size() const
+{
+	return centerX.size();
+}
+
+void
+BoundsBatch::add(const Vector3& center, const Vector3& extent)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+	if (isOriented)
+	{
+		const Matrix3 identity(true);
+		for (unsigned i = 0; i < 9; ++i)
+		{
+			axes[i].push_back(identity.data()[i]);
+		}
+	}
+}
+
+void
+BoundsBatch::add(const Vector3& center, const Vector3& extent, const Matrix3& boxAxes)
+{
+	if (!isOriented)
+	{
+		// Every box added so far was axis aligned
+		const Matrix3 identity(true);
+		for (unsigned i = 0; i < 9; ++i)
+		{
+			axes[i].assign(size(), identity.data()[i]);
+		}
+		isOriented = true;
+	}
+
+	add(center, extent);
+	for (unsigned i = 0; i < 9; ++i)
+	{
+		axes[i].back() = boxAxes.data()[i];
+	}
+}
+
+void
+BoundsBatch::add(const BoxBV& box)
+{
+	add(box.center, box.extent, box.axes);
+}
+
+bool
+BoundsBatch::isVisible(const std::vector<uint64_t>& visible, unsigned index)
+{
+	return (visible[index / 64] >> (index % 64)) & 1;
+}
+
+void
+BoundsBatch::cull(const Frustum& frustum, std::vector<uint64_t>& visible) const
+{
+	const unsigned n = size();
+	visible.assign((n + 63) / 64, 0);
+
+	// p/n vertex test in center and extent form, the box reaches
+	// 	sum |n . axis| * extent toward the plane from its center
+	Simd::Lanes nx[Frustum::NUM_PLANES], ny[Frustum::NUM_PLANES], nz[Frustum::NUM_PLANES];
+	Simd::Lanes nd[Frustum::NUM_PLANES];
+	Simd::Lanes absX[Frustum::NUM_PLANES], absY[Frustum::NUM_PLANES], absZ[Frustum::NUM_PLANES];
+	for (unsigned p = 0; p < Frustum::NUM_PLANES; ++p)
+	{
+		const Plane& plane = frustum.getPlane(p);
+		nx[p] = Simd::set(plane.normal.x);
+		ny[p] = Simd::set(plane.normal.y);
+		nz[p] = Simd::set(plane.normal.z);
+		nd[p] = Simd::set(plane.d);
+		absX[p] = Simd::abs(nx[p]);
+		absY[p] = Simd::abs(ny[p]);
+		absZ[p] = Simd::abs(nz[p]);
+	}
+	const Simd::Lanes zero = Simd::set(0);
+	constexpr unsigned LANE_BITS = (1u << Simd::WIDTH) - 1;
+
+	unsigned i = 0;
+	for (; i + Simd::WIDTH <= n; i += Simd::WIDTH)
+	{
+		const Simd::Lanes cx = Simd::load(&centerX[i]);
+		const Simd::Lanes cy = Simd::load(&centerY[i]);
+		const Simd::Lanes cz = Simd::load(&centerZ[i]);
+		const Simd::Lanes ex = Simd::load(&extentX[i]);
+		const Simd::Lanes ey = Simd::load(&extentY[i]);
+		const Simd::Lanes ez = Simd::load(&extentZ[i]);
+
+		unsigned outside = 0;
+		if (isOriented)
+		{
+			Simd::Lanes a[9];
+			for (unsigned k = 0; k < 9; ++k)
+			{
+				a[k] = Simd::load(&axes[k][i]);
+			}
+			for (unsigned p = 0; p < Frustum::NUM_PLANES; ++p)
+			{
+				Simd::Lanes onRight = Simd::mulAdd(nz[p], a[2], Simd::mulAdd(ny[p], a[1], Simd::mul(nx[p], a[0])));
+				Simd::Lanes onUp 	= Simd::mulAdd(nz[p], a[5], Simd::mulAdd(ny[p], a[4], Simd::mul(nx[p], a[3])));
+				Simd::Lanes onBack 	= Simd::mulAdd(nz[p], a[8], Simd::mulAdd(ny[p], a[7], Simd::mul(nx[p], a[6])));
+				Simd::Lanes reach 	= Simd::mulAdd(Simd::abs(onBack), ez,
+					Simd::mulAdd(Simd::abs(onUp), ey, Simd::mul(Simd::abs(onRight), ex)));
+				Simd::Lanes distance = Simd::mulAdd(nz[p], cz, Simd::mulAdd(ny[p], cy, Simd::mulAdd(nx[p], cx, nd[p])));
+				// distance + reach < 0 means every corner is behind the plane
+				outside |= Simd::lessMask(Simd::add(distance, reach), zero);
+			}
+		}
+		else
+		{
+			for (unsigned p = 0; p < Frustum::NUM_PLANES; ++p)
+			{
+				Simd::Lanes reach = Simd::mulAdd(absZ[p], ez, Simd::mulAdd(absY[p], ey, Simd::mul(absX[p], ex)));
+				Simd::Lanes distance = Simd::mulAdd(nz[p], cz, Simd::mulAdd(ny[p], cy, Simd::mulAdd(nx[p], cx, nd[p])));
+				outside |= Simd::lessMask(Simd::add(distance, reach), zero);
+			}
+		}
+
+		// WIDTH divides 64 so a batch never straddles two words
+		visible[i / 64] |= static_cast<uint64_t>(~outside & LANE_BITS) << (i % 64);
+	}
+
+	for (; i < n; ++i)
+	{
+		const float extent[3] = { extentX[i], extentY[i], extentZ[i] };
+		const Vector3 center(centerX[i], centerY[i], centerZ[i]);
+		bool isInside = true;
+		for (unsigned p = 0; p < Frustum::NUM_PLANES && isInside; ++p)
+		{
+			const Plane& plane = frustum.getPlane(p);
+			float reach = 0;
+			for (unsigned c = 0; c < 3; ++c)
+			{
+				float onAxis = isOriented
+					? plane.normal.x * axes[3 * c][i] + plane.normal.y * axes[3 * c + 1][i] + plane.normal.z * axes[3 * c + 2][i]
+					: plane.normal[c];
+				reach += std::fabs(onAxis) * extent[c];
+			}
+			isInside = plane.dist(center) + reach >= 0;
+		}
+		if (isInside)
+		{
+			visible[i / 64] |= uint64_t(1) << (i % 64);
+		}
+	}
+}
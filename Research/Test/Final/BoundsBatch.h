@@ -0,0 +1,55 @@
+/*
+  FileName    : BoundsBatch.h
+  Author      : Zachary Zuch
+  Description : Structure-of-arrays list of boxes in center and half extent
+  				form, optionally oriented, culled against all six frustum
+  				planes at once with the SIMD lanes in Simd.h.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vector3.h"
+#include "Matrix3.h"
+#include "Frustum.h"
+
+struct BoundsBatch
+{
+	BoundsBatch();
+
+	void
+	clear();
+
+	void
+	reserve(unsigned count);
+
+	unsigned
+	size() const;
+
+	// Axis aligned box
+	void
+	add(const Vector3& center, const Vector3& extent);
+
+	// Oriented box, the columns of axes are its local x, y and z
+	void
+	add(const Vector3& center, const Vector3& extent, const Matrix3& axes);
+
+	void
+	add(const BoxBV& box);
+
+	// Bit i % 64 of visible[i / 64] is set when box i is inside or crosses
+	// 	the frustum. Boxes are tested a SIMD batch at a time.
+	void
+	cull(const Frustum& frustum, std::vector<uint64_t>& visible) const;
+
+	static bool
+	isVisible(const std::vector<uint64_t>& visible, unsigned index);
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	// Only filled once an oriented box is added. axes[3 * c + r] is row r of
+	// 	column c, matching Matrix3::data().
+	std::vector<float> axes[9];
+	bool isOriented;
+};
@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <cmath>
+
+#include "CompressedClip.h"
+
+namespace
+{
+	constexpr float MAX_QUANTIZED = 65535.0f;
+	// Rotation components get 15 bits, the top bits hold the dropped index
+	constexpr float MAX_ROTATION_QUANTIZED = 32767.0f;
+	constexpr uint16_t ROTATION_VALUE_MASK = 0x7FFF;
+	// The three smallest components of a unit quaternion are within this
+	constexpr float ROTATION_RANGE = 0.70710678f;
+
+	float
+	vectorError(const Vector3& a, const Vector3& b)
+	{
+		return (a - b).length();
+	}
+
+	float
+	rotationError(const Quaternion& a, const Quaternion& b)
+	{
+		const float dot = std::fabs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+		return 2.0f * std::acos(dot < 1.0f ? dot : 1.0f);
+	}
+
+	// Indices of the keys to keep. A key is dropped when interpolating
+	// 	between the kept keys around it stays within tolerance of every
+	// 	key in between. A constant track keeps one key.
+	template<typename Key, typename Error>
+	std::vector<unsigned>
+	reduceKeys(const std::vector<Key>& keys, float tolerance, Error error)
+	{
+		std::vector<unsigned> kept;
+		if (keys.empty())
+		{
+			return kept;
+		}
+		kept.push_back(0);
+		bool isConstant = true;
+		for (unsigned i = 1; i < keys.size() && isConstant; ++i)
+		{
+			isConstant = error(keys[0].value, keys[i].value) <= tolerance;
+		}
+		if (isConstant)
+		{
+			return kept;
+		}
+
+		unsigned anchor = 0;
+		for (unsigned candidate = 2; candidate < keys.size(); ++candidate)
+		{
+			const float span = keys[candidate].timeStamp - keys[anchor].timeStamp;
+			bool canSkip = span > 0.0f;
+			for (unsigned middle = anchor + 1; middle < candidate && canSkip; ++middle)
+			{
+				auto value = keys[anchor].value;
+				const float blend = (keys[middle].timeStamp - keys[anchor].timeStamp) / span;
+				canSkip = error(value.interpolate(keys[candidate].value, blend), keys[middle].value) <= tolerance;
+			}
+			if (!canSkip)
+			{
+				anchor = candidate - 1;
+				kept.push_back(anchor);
+			}
+		}
+		kept.push_back(keys.size() - 1);
+		return kept;
+	}
+
+	uint16_t
+	quantize(float value, float min, float step)
+	{
+		if (step <= 0.0f)
+		{
+			return 0;
+		}
+		const float scaled = std::round((value - min) / step);
+		return static_cast<uint16_t> (scaled < 0.0f ? 0.0f : (scaled > MAX_QUANTIZED ? MAX_QUANTIZED : scaled));
+	}
+}
+
+/****************************************************************************************/
+// ClipCompressionSettings Struct
+
+ClipCompressionSettings::ClipCompressionSettings()
+: positionTolerance(1e-3f)
+, rotationTolerance(1e-3f)
+, scaleTolerance(1e-3f)
+{ }
+
+/****************************************************************************************/
+// CompressedClip Class
+
+CompressedClip::CompressedClip(const std::vector<Animation*>& bones, const ClipCompressionSettings& settings)
+: m_tracks()
+, m_keys()
+, m_uncompressedBytes(0)
+{
+	static const std::vector<Vector3Key> NO_VECTOR_KEYS;
+	static const std::vector<QuaternionKey> NO_ROTATION_KEYS;
+	m_tracks.reserve(bones.size() * NUM_TRACK_TYPES);
+	for (const Animation* clip : bones)
+	{
+		addVectorTrack(clip != nullptr ? clip->positions : NO_VECTOR_KEYS, settings.positionTolerance);
+		addRotationTrack(clip != nullptr ? clip->rotations : NO_ROTATION_KEYS, settings.rotationTolerance);
+		addVectorTrack(clip != nullptr ? clip->scalings : NO_VECTOR_KEYS, settings.scaleTolerance);
+		if (clip != nullptr)
+		{
+			m_uncompressedBytes += clip->positions.size() * sizeof(Vector3Key)
+				+ clip->rotations.size() * sizeof(QuaternionKey)
+				+ clip->scalings.size() * sizeof(Vector3Key);
+		}
+	}
+	m_keys.shrink_to_fit();
+}
+
+void
+CompressedClip::getLocalPose(unsigned bone, float time, AnimationCursor& cursor, Vector3& position,
+	Quaternion& rotation, Vector3& scale) const
+{
+	const Track* tracks = &m_tracks[bone * NUM_TRACK_TYPES];
+	position = sampleVector(tracks[POSITION], time, cursor.position, Vector3());
+	rotation = sampleRotation(tracks[ROTATION], time, cursor.rotation);
+	scale = sampleVector(tracks[SCALE], time, cursor.scaling, Vector3(1.0f, 1.0f, 1.0f));
+}
+
+unsigned
+CompressedClip::numKeys() const
+{
+	return m_keys.size() / VALUES_PER_KEY;
+}
+
+unsigned
+CompressedClip::sizeInBytes() const
+{
+	return m_keys.size() * sizeof(uint16_t) + m_tracks.size() * sizeof(Track);
+}
+
+unsigned
+CompressedClip::uncompressedBytes() const
+{
+	return m_uncompressedBytes;
+}
+
+void
+CompressedClip::printStats(std::ostream& out) const
+{
+	out << "Compressed clip: " << numKeys() << " keys, " << uncompressedBytes() << " bytes to "
+		<< sizeInBytes() << " bytes" << std::endl;
+}
+
+void
+CompressedClip::addVectorTrack(const std::vector<Vector3Key>& keys, float tolerance)
+{
+	const std::vector<unsigned> kept = reduceKeys(keys, tolerance, vectorError);
+	Track& track = beginTrack(kept.empty() ? 0.0f : keys[kept.front()].timeStamp,
+		kept.empty() ? 0.0f : keys[kept.back()].timeStamp, kept.size());
+
+	Vector3 min(0.0f, 0.0f, 0.0f);
+	Vector3 max(0.0f, 0.0f, 0.0f);
+	if (!kept.empty())
+	{
+		min = max = keys[kept[0]].value;
+	}
+	for (unsigned index : kept)
+	{
+		for (unsigned c = 0; c < 3; ++c)
+		{
+			min[c] = std::min(min[c], keys[index].value[c]);
+			max[c] = std::max(max[c], keys[index].value[c]);
+		}
+	}
+	for (unsigned c = 0; c < 3; ++c)
+	{
+		track.min[c] = min[c];
+		track.step[c] = (max[c] - min[c]) / MAX_QUANTIZED;
+	}
+
+	uint16_t* out = &m_keys[track.offset];
+	for (unsigned index : kept)
+	{
+		*out++ = quantizeTime(track, keys[index].timeStamp);
+		for (unsigned c = 0; c < 3; ++c)
+		{
+			*out++ = quantize(keys[index].value[c], track.min[c], track.step[c]);
+		}
+	}
+}
+
+void
+CompressedClip::addRotationTrack(const std::vector<QuaternionKey>& keys, float tolerance)
+{
+	const std::vector<unsigned> kept = reduceKeys(keys, tolerance, rotationError);
+	Track& track = beginTrack(kept.empty() ? 0.0f : keys[kept.front()].timeStamp,
+		kept.empty() ? 0.0f : keys[kept.back()].timeStamp, kept.size());
+
+	uint16_t* out = &m_keys[track.offset];
+	for (unsigned index : kept)
+	{
+		const Quaternion& q = keys[index].value;
+		const float components[4] = { q.x, q.y, q.z, q.w };
+		unsigned largest = 0;
+		for (unsigned c = 1; c < 4; ++c)
+		{
+			if (std::fabs(components[c]) > std::fabs(components[largest]))
+			{
+				largest = c;
+			}
+		}
+		// q and -q are the same rotation, keep the dropped component positive
+		const float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+		*out++ = quantizeTime(track, keys[index].timeStamp);
+		unsigned stored = 0;
+		for (unsigned c = 0; c < 4; ++c)
+		{
+			if (c == largest)
+			{
+				continue;
+			}
+			const float unit = (sign * components[c] / ROTATION_RANGE) * 0.5f + 0.5f;
+			const float scaled = std::round(unit * MAX_ROTATION_QUANTIZED);
+			uint16_t value = static_cast<uint16_t> (scaled < 0.0f ? 0.0f
+				: (scaled > MAX_ROTATION_QUANTIZED ? MAX_ROTATION_QUANTIZED : scaled));
+			// Two bits of the dropped index ride on the first two values
+			if (stored < 2)
+			{
+				value |= ((largest >> stored) & 1) << 15;
+			}
+			*out++ = value;
+			++stored;
+		}
+	}
+}
+
+CompressedClip::Track&
+CompressedClip::beginTrack(float beginTime, float endTime, unsigned numKeys)
+{
+	Track track;
+	track.offset = m_keys.size();
+	track.numKeys = numKeys;
+	track.beginTime = beginTime;
+	track.timeStep = (endTime - beginTime) / MAX_QUANTIZED;
+	for (unsigned c = 0; c < 3; ++c)
+	{
+		track.min[c] = 0.0f;
+		track.step[c] = 0.0f;
+	}
+	m_tracks.push_back(track);
+	m_keys.resize(m_keys.size() + numKeys * VALUES_PER_KEY);
+	return m_tracks.back();
+}
+
+uint16_t
+CompressedClip::quantizeTime(const Track& track, float time)
+{
+	return quantize(time, track.beginTime, track.timeStep);
+}
+
+float
+CompressedClip::keyTime(const Track& track, unsigned key) const
+{
+	return track.beginTime + m_keys[track.offset + key * VALUES_PER_KEY] * track.timeStep;
+}
+
+unsigned
+CompressedClip::findKey(const Track& track, float time, unsigned& cursor) const
+{
+	const unsigned size = track.numKeys;
+	if (size < 2 || time >= keyTime(track, size - 1))
+	{
+		return size;
+	}
+
+	unsigned index = cursor;
+	if (index >= 1 && index < size && (index == 1 || keyTime(track, index - 1) <= time))
+	{
+		for (unsigned step = 0; step < Animation::MAX_CURSOR_STEPS && keyTime(track, index) <= time; ++step)
+		{
+			++index;
+		}
+		if (keyTime(track, index) > time)
+		{
+			cursor = index;
+			return index;
+		}
+	}
+
+	// First key after time, there is one since time is before the last
+	unsigned low = 1;
+	unsigned high = size - 1;
+	while (low < high)
+	{
+		const unsigned middle = (low + high) / 2;
+		if (keyTime(track, middle) > time)
+		{
+			high = middle;
+		}
+		else
+		{
+			low = middle + 1;
+		}
+	}
+	cursor = low;
+	return low;
+}
+
+Vector3
+CompressedClip::decodeVector(const Track& track, unsigned key) const
+{
+	const uint16_t* values = &m_keys[track.offset + key * VALUES_PER_KEY + 1];
+	return Vector3(track.min[0] + values[0] * track.step[0],
+		track.min[1] + values[1] * track.step[1],
+		track.min[2] + values[2] * track.step[2]);
+}
+
+Quaternion
+CompressedClip::decodeRotation(const Track& track, unsigned key) const
+{
+	const uint16_t* values = &m_keys[track.offset + key * VALUES_PER_KEY + 1];
+	const unsigned largest = (values[0] >> 15) | ((values[1] >> 15) << 1);
+	float components[4];
+	float sumSquares = 0.0f;
+	unsigned stored = 0;
+	for (unsigned c = 0; c < 4; ++c)
+	{
+		if (c == largest)
+		{
+			continue;
+		}
+		const float unit = (values[stored] & ROTATION_VALUE_MASK) / MAX_ROTATION_QUANTIZED;
+		components[c] = (unit * 2.0f - 1.0f) * ROTATION_RANGE;
+		sumSquares += components[c] * components[c];
+		++stored;
+	}
+	components[largest] = std::sqrt(sumSquares < 1.0f ? 1.0f - sumSquares : 0.0f);
+	return Quaternion(components[0], components[1], components[2], components[3]);
+}
+
+Vector3
+CompressedClip::sampleVector(const Track& track, float time, unsigned& cursor, const Vector3& empty) const
+{
+	if (track.numKeys == 0)
+	{
+		return empty;
+	}
+	const unsigned index = findKey(track, time, cursor);
+	if (index >= track.numKeys)
+	{
+		return decodeVector(track, track.numKeys - 1);
+	}
+	const float previousTime = keyTime(track, index - 1);
+	const float totalTime = keyTime(track, index) - previousTime;
+	Vector3 prev = decodeVector(track, index - 1);
+	return totalTime > 0.0f
+		? prev.interpolate(decodeVector(track, index), (time - previousTime) / totalTime)
+		: decodeVector(track, index);
+}
+
+Quaternion
+CompressedClip::sampleRotation(const Track& track, float time, unsigned& cursor) const
+{
+	if (track.numKeys == 0)
+	{
+		return Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	const unsigned index = findKey(track, time, cursor);
+	if (index >= track.numKeys)
+	{
+		return decodeRotation(track, track.numKeys - 1);
+	}
+	const float previousTime = keyTime(track, index - 1);
+	const float totalTime = keyTime(track, index) - previousTime;
+	Quaternion prev = decodeRotation(track, index - 1);
+	return totalTime > 0.0f
+		? prev.interpolate(decodeRotation(track, index), (time - previousTime) / totalTime)
+		: decodeRotation(track, index);
+}
@@ -0,0 +1,117 @@
+/*
+  FileName    : CompressedClip.h
+  Author      : Zachary Zuch
+  Description : One clip of a whole skeleton packed into a single array of
+  				16 bit values. Keys that interpolation already reproduces are
+  				dropped, times and translations are quantized over each
+  				track's range and rotations are stored as their smallest
+  				three components in 48 bits. Sampling decodes straight from
+  				the packed array.
+*/
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Animation.h"
+#include "Quaternion.h"
+#include "Vector3.h"
+
+struct ClipCompressionSettings
+{
+	ClipCompressionSettings();
+
+	// Largest error a dropped key may leave, in model units
+	float positionTolerance;
+	// In radians
+	float rotationTolerance;
+	float scaleTolerance;
+};
+
+class CompressedClip
+{
+public:
+
+	// bones[i] is the clip of bone i, nullptr for bones without a channel
+	CompressedClip(const std::vector<Animation*>& bones,
+		const ClipCompressionSettings& settings = ClipCompressionSettings());
+
+	// Same sampling rules as Animation::getLocalPose
+	void
+	getLocalPose(unsigned bone, float time, AnimationCursor& cursor, Vector3& position, Quaternion& rotation,
+		Vector3& scale) const;
+
+	unsigned
+	numKeys() const;
+
+	// Packed keys and track headers
+	unsigned
+	sizeInBytes() const;
+
+	// Bytes the same tracks take as Animation keys
+	unsigned
+	uncompressedBytes() const;
+
+	void
+	printStats(std::ostream& out = std::cout) const;
+
+	// Values per key, a time and three components
+	static constexpr unsigned VALUES_PER_KEY = 4;
+
+private:
+
+	struct Track
+	{
+		// First value of the track in m_keys
+		unsigned offset;
+		unsigned numKeys;
+		float beginTime;
+		float timeStep;
+		// Dequantized component is min + value * step
+		float min[3];
+		float step[3];
+	};
+
+	enum TrackType
+	{
+		POSITION, ROTATION, SCALE, NUM_TRACK_TYPES
+	};
+
+	void
+	addVectorTrack(const std::vector<Vector3Key>& keys, float tolerance);
+
+	void
+	addRotationTrack(const std::vector<QuaternionKey>& keys, float tolerance);
+
+	// Header for keys and room for them at the end of m_keys
+	Track&
+	beginTrack(float beginTime, float endTime, unsigned numKeys);
+
+	static uint16_t
+	quantizeTime(const Track& track, float time);
+
+	float
+	keyTime(const Track& track, unsigned key) const;
+
+	// Same search as Animation's, over the packed times
+	unsigned
+	findKey(const Track& track, float time, unsigned& cursor) const;
+
+	Vector3
+	decodeVector(const Track& track, unsigned key) const;
+
+	Quaternion
+	decodeRotation(const Track& track, unsigned key) const;
+
+	Vector3
+	sampleVector(const Track& track, float time, unsigned& cursor, const Vector3& empty) const;
+
+	Quaternion
+	sampleRotation(const Track& track, float time, unsigned& cursor) const;
+
+	// NUM_TRACK_TYPES per bone
+	std::vector<Track> m_tracks;
+	std::vector<uint16_t> m_keys;
+	unsigned m_uncompressedBytes;
+};
@@ -0,0 +1,193 @@
+#include "CpuSkinner.h"
+#include "GLState.h"
+#include "TaskPool.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	constexpr unsigned FLOATS_PER_VERTEX = Mesh::FLOATS_PER_VERTEX;
+	constexpr unsigned NUM_INFLUENCES = Mesh::NUM_BONE_INDICES;
+
+	// Weights of one vertex scaled to sum to one, 0 for unusable bones.
+	// 	Returns false when no influence is left.
+	bool
+	influences(const float* weights, const unsigned* indices, unsigned numBones, float normalized[NUM_INFLUENCES])
+	{
+		float sum = 0.0f;
+		for (unsigned i = 0; i < NUM_INFLUENCES; ++i)
+		{
+			normalized[i] = indices[i] < numBones ? weights[i] : 0.0f;
+			sum += normalized[i];
+		}
+		if (sum <= 0.0f)
+		{
+			return false;
+		}
+		for (unsigned i = 0; i < NUM_INFLUENCES; ++i)
+		{
+			normalized[i] /= sum;
+		}
+		return true;
+	}
+}
+
+CpuSkinner::CpuSkinner(Mesh* mesh)
+: m_mesh(mesh)
+, m_vbo()
+, m_capacity(0)
+, m_vertices(mesh->getVertexData())
+{ }
+
+CpuSkinner::~CpuSkinner()
+{
+	if (m_capacity != 0)
+	{
+		m_mesh->setVertexBuffer(0);
+		GLState::current().deleteBuffer(m_vbo);
+	}
+}
+
+void
+CpuSkinner::skin(const std::vector<Matrix4>& palette)
+{
+	const Mesh& mesh = *m_mesh;
+	float* out = m_vertices.data();
+	TaskPool::shared().parallelFor(0, mesh.numVertices(), VERTICES_PER_TASK,
+		[&mesh, &palette, out](unsigned begin, unsigned end)
+	{
+		skinRange(mesh, palette, begin, end - begin, out + begin * FLOATS_PER_VERTEX);
+	});
+}
+
+void
+CpuSkinner::upload()
+{
+	const unsigned bytes = m_vertices.size() * sizeof(float);
+	const bool isFirst = m_capacity == 0;
+	if (isFirst)
+	{
+		glGenBuffers ( 1, &m_vbo );
+	}
+
+	GLState::current().bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	if (bytes > m_capacity)
+	{
+		m_capacity = bytes;
+	}
+	// Orphan last frame's storage so the driver never waits on it
+	glBufferData ( GL_ARRAY_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW );
+	glBufferSubData ( GL_ARRAY_BUFFER, 0, bytes, m_vertices.data() );
+	GLState::current().unbindBuffer(GL_ARRAY_BUFFER);
+
+	if (isFirst)
+	{
+		m_mesh->setVertexBuffer(m_vbo);
+	}
+}
+
+const std::vector<float>&
+CpuSkinner::getVertexData() const
+{
+	return m_vertices;
+}
+
+void
+CpuSkinner::skinRange(const Mesh& mesh, const std::vector<Matrix4>& palette, unsigned first, unsigned count,
+	float* out)
+{
+#if defined(__SSE2__)
+	const float* vertices = mesh.getVertexData().data();
+	const float* weights = mesh.getBoneWeights().data();
+	const unsigned* indices = mesh.getBoneIndices().data();
+	const unsigned numBones = palette.size();
+	for (unsigned v = first; v < first + count; ++v, out += FLOATS_PER_VERTEX)
+	{
+		const float* in = vertices + v * FLOATS_PER_VERTEX;
+		float w[NUM_INFLUENCES];
+		if (!influences(weights + v * NUM_INFLUENCES, indices + v * NUM_INFLUENCES, numBones, w))
+		{
+			for (unsigned i = 0; i < FLOATS_PER_VERTEX; ++i)
+			{
+				out[i] = in[i];
+			}
+			continue;
+		}
+
+		// Blend the bone matrices a column at a time
+		__m128 columns[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for (unsigned i = 0; i < NUM_INFLUENCES; ++i)
+		{
+			if (w[i] == 0.0f)
+			{
+				continue;
+			}
+			const float* bone = palette[indices[v * NUM_INFLUENCES + i]].data();
+			const __m128 weight = _mm_set1_ps(w[i]);
+			for (unsigned c = 0; c < 4; ++c)
+			{
+				columns[c] = _mm_add_ps(columns[c], _mm_mul_ps(_mm_loadu_ps(bone + 4 * c), weight));
+			}
+		}
+
+		__m128 position = _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(in[0])), columns[3]);
+		position = _mm_add_ps(position, _mm_mul_ps(columns[1], _mm_set1_ps(in[1])));
+		position = _mm_add_ps(position, _mm_mul_ps(columns[2], _mm_set1_ps(in[2])));
+		__m128 normal = _mm_mul_ps(columns[0], _mm_set1_ps(in[3]));
+		normal = _mm_add_ps(normal, _mm_mul_ps(columns[1], _mm_set1_ps(in[4])));
+		normal = _mm_add_ps(normal, _mm_mul_ps(columns[2], _mm_set1_ps(in[5])));
+
+		// Each store spills one lane into the next field, written after it
+		_mm_storeu_ps(out, position);
+		_mm_storeu_ps(out + 3, normal);
+		out[6] = in[6];
+		out[7] = in[7];
+	}
+#else
+	skinReference(mesh, palette, first, count, out);
+#endif
+}
+
+void
+CpuSkinner::skinReference(const Mesh& mesh, const std::vector<Matrix4>& palette, unsigned first, unsigned count,
+	float* out)
+{
+	const std::vector<float>& vertices = mesh.getVertexData();
+	const std::vector<float>& weights = mesh.getBoneWeights();
+	const std::vector<unsigned>& indices = mesh.getBoneIndices();
+	for (unsigned v = first; v < first + count; ++v, out += FLOATS_PER_VERTEX)
+	{
+		const float* in = &vertices[v * FLOATS_PER_VERTEX];
+		for (unsigned i = 0; i < FLOATS_PER_VERTEX; ++i)
+		{
+			out[i] = in[i];
+		}
+		float w[NUM_INFLUENCES];
+		if (!influences(&weights[v * NUM_INFLUENCES], &indices[v * NUM_INFLUENCES], palette.size(), w))
+		{
+			continue;
+		}
+
+		float blended[16] = { };
+		for (unsigned i = 0; i < NUM_INFLUENCES; ++i)
+		{
+			if (w[i] == 0.0f)
+			{
+				continue;
+			}
+			const float* bone = palette[indices[v * NUM_INFLUENCES + i]].data();
+			for (unsigned e = 0; e < 16; ++e)
+			{
+				blended[e] += w[i] * bone[e];
+			}
+		}
+		// Column major, the normal ignores the translation column
+		for (unsigned row = 0; row < 3; ++row)
+		{
+			out[row] = blended[row] * in[0] + blended[4 + row] * in[1] + blended[8 + row] * in[2] + blended[12 + row];
+			out[3 + row] = blended[row] * in[3] + blended[4 + row] * in[4] + blended[8 + row] * in[5];
+		}
+	}
+}
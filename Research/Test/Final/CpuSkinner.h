@@ -0,0 +1,64 @@
+/*
+  FileName    : CpuSkinner.h
+  Author      : Zachary Zuch
+  Description : Linear blend skinning of a mesh on the CPU. Vertices are
+  				skinned in chunks on the shared task pool, each vertex
+  				blending its three bone matrices a column at a time with SSE,
+  				and the result is streamed into a buffer the mesh draws from.
+*/
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "Matrix4.h"
+#include "Mesh.h"
+
+class CpuSkinner
+{
+public:
+
+	// mesh must have bone data and outlive the skinner
+	explicit CpuSkinner(Mesh* mesh);
+
+	// Points the mesh back at its own vertex buffer
+	~CpuSkinner();
+
+	// Disable default copy ctor and copy assignment
+	CpuSkinner (const CpuSkinner&) = delete;
+	CpuSkinner& operator= (const CpuSkinner&) = delete;
+
+	// Skin every vertex with palette into the CPU side copy
+	void
+	skin(const std::vector<Matrix4>& palette);
+
+	// Orphan the stream buffer, send the skinned vertices and have the mesh
+	// 	draw them
+	void
+	upload();
+
+	// Vertices laid out like Mesh::getVertexData
+	const std::vector<float>&
+	getVertexData() const;
+
+	// Skin vertices [first, first + count) of mesh into out, which holds
+	// 	FLOATS_PER_VERTEX floats per vertex starting at vertex first.
+	// 	Weights are normalized to sum to one and influences naming a bone
+	// 	past the palette are ignored.
+	static void
+	skinRange(const Mesh& mesh, const std::vector<Matrix4>& palette, unsigned first, unsigned count, float* out);
+
+	// One scalar vertex at a time, what skinRange is checked against
+	static void
+	skinReference(const Mesh& mesh, const std::vector<Matrix4>& palette, unsigned first, unsigned count, float* out);
+
+	// Vertices skinned by one pool task
+	static constexpr unsigned VERTICES_PER_TASK = 2048;
+
+private:
+
+	Mesh* m_mesh;
+	GLuint m_vbo;
+	unsigned m_capacity;
+	std::vector<float> m_vertices;
+};
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "CullContext.h"
+#include "Simd.h"
+
+namespace
+{
+	// Shared by every context so a model moved between contexts never sees
+	// 	a version it was already built for
+	std::atomic<unsigned> s_nextVersion(1);
+}
+
+/****************************************************************************************/
+// InstancePlanes Struct
+
+InstancePlanes::InstancePlanes()
+: frusta()
+, worlds()
+, version(0)
+{ }
+
+/****************************************************************************************/
+// CullContext Class
+
+CullContext::CullContext()
+: m_viewProjection()
+, m_world()
+, m_version(0)
+{
+	m_viewProjection.setToZero();
+}
+
+void
+CullContext::update(const Camera& camera)
+{
+	Matrix4 viewProjection = camera.getProjectionMatrix();
+	viewProjection *= camera.getViewMatrix(true).getTransform();
+	if (m_version != 0
+		&& std::memcmp(viewProjection.data(), m_viewProjection.data(), MATRIX_FLOATS * sizeof(float)) == 0)
+	{
+		return;
+	}
+
+	m_viewProjection = viewProjection;
+	// Transpose to match proper elements since algorithm uses the transpose of my matrix
+	viewProjection.transpose();
+	m_world.init(viewProjection);
+	m_version = s_nextVersion++;
+}
+
+const Frustum&
+CullContext::getWorldFrustum() const
+{
+	return m_world;
+}
+
+unsigned
+CullContext::getVersion() const
+{
+	return m_version;
+}
+
+void
+CullContext::transformPlanes(const std::vector<Transform>& worlds, InstancePlanes& instances) const
+{
+	const unsigned count = worlds.size();
+	const bool isCameraChanged = instances.version != m_version;
+	instances.frusta.resize(count);
+	instances.worlds.resize(count * MATRIX_FLOATS, 0);
+	instances.version = m_version;
+
+	// Gather the dirty instances' matrices as structure-of-arrays, padded to
+	// 	whole SIMD batches so the kernel has no tail
+	std::vector<unsigned> dirty;
+	float world[MATRIX_FLOATS];
+	for (unsigned i = 0; i < count; ++i)
+	{
+		worlds[i].getTransform(world);
+		float* cached = &instances.worlds[i * MATRIX_FLOATS];
+		if (isCameraChanged || std::memcmp(world, cached, sizeof(world)) != 0)
+		{
+			std::memcpy(cached, world, sizeof(world));
+			dirty.push_back(i);
+		}
+	}
+	if (dirty.empty())
+	{
+		return;
+	}
+
+	const unsigned padded = (dirty.size() + Simd::WIDTH - 1) / Simd::WIDTH * Simd::WIDTH;
+	std::vector<float> columns(MATRIX_FLOATS * padded, 0);
+	for (unsigned j = 0; j < dirty.size(); ++j)
+	{
+		const float* cached = &instances.worlds[dirty[j] * MATRIX_FLOATS];
+		for (unsigned k = 0; k < MATRIX_FLOATS; ++k)
+		{
+			columns[k * padded + j] = cached[k];
+		}
+	}
+
+	std::vector<float> planes(4 * padded);
+	const Simd::Lanes one = Simd::set(1);
+	const Simd::Lanes tiny = Simd::set(1e-30f);
+	for (unsigned p = 0; p < Frustum::NUM_PLANES; ++p)
+	{
+		const Plane& plane = m_world.getPlane(p);
+		const Simd::Lanes a = Simd::set(plane.normal.x);
+		const Simd::Lanes b = Simd::set(plane.normal.y);
+		const Simd::Lanes c = Simd::set(plane.normal.z);
+		const Simd::Lanes d = Simd::set(plane.d);
+		for (unsigned j = 0; j < padded; j += Simd::WIDTH)
+		{
+			// Component k of M^T p is column k of M dotted with p
+			Simd::Lanes transformed[4];
+			for (unsigned k = 0; k < 4; ++k)
+			{
+				const float* column = &columns[4 * k * padded + j];
+				transformed[k] = Simd::mulAdd(a, Simd::load(column),
+					Simd::mulAdd(b, Simd::load(column + padded),
+					Simd::mulAdd(c, Simd::load(column + 2 * padded),
+					Simd::mul(d, Simd::load(column + 3 * padded)))));
+			}
+			Simd::Lanes lengthSquared = Simd::mulAdd(transformed[0], transformed[0],
+				Simd::mulAdd(transformed[1], transformed[1], Simd::mul(transformed[2], transformed[2])));
+			Simd::Lanes inverseLength = Simd::div(one, Simd::sqrt(Simd::max(lengthSquared, tiny)));
+			for (unsigned k = 0; k < 4; ++k)
+			{
+				Simd::store(&planes[k * padded + j], Simd::mul(transformed[k], inverseLength));
+			}
+		}
+
+		for (unsigned j = 0; j < dirty.size(); ++j)
+		{
+			instances.frusta[dirty[j]].setPlane(p,
+				{ planes[j], planes[padded + j], planes[2 * padded + j], planes[3 * padded + j] });
+		}
+	}
+}
@@ -0,0 +1,58 @@
+/*
+  FileName    : CullContext.h
+  Author      : Zachary Zuch
+  Description : Frustum planes extracted once per frame from the camera and
+  				moved into the model space of every instance with a batched
+  				SIMD pass, so instances no longer build their own Frustum.
+*/
+#pragma once
+
+#include <vector>
+
+#include "Camera.h"
+#include "Frustum.h"
+#include "Transform.h"
+
+// Model space planes of one model's instances along with what they were
+// 	built from, owned by the model and refreshed by CullContext
+struct InstancePlanes
+{
+	InstancePlanes();
+
+	std::vector<Frustum> frusta;
+	// Column major world matrix of every instance, 16 floats each
+	std::vector<float> worlds;
+	// Version of the context the planes were built for, 0 is never
+	unsigned version;
+};
+
+class CullContext
+{
+public:
+
+	CullContext();
+
+	// Re-extracts the world planes only when the view projection changed
+	void
+	update(const Camera& camera);
+
+	const Frustum&
+	getWorldFrustum() const;
+
+	// Changes every time the world planes do, never 0 once updated
+	unsigned
+	getVersion() const;
+
+	// Planes become M^T p in the space of each world matrix M. Only the
+	// 	instances whose world matrix changed are redone unless the camera moved.
+	void
+	transformPlanes(const std::vector<Transform>& worlds, InstancePlanes& instances) const;
+
+	static constexpr unsigned MATRIX_FLOATS = 16;
+
+private:
+
+	Matrix4 m_viewProjection;
+	Frustum m_world;
+	unsigned m_version;
+};
@@ -4,6 +4,7 @@
 SphereDebug::SphereDebug()
 	: boxMesh(nullptr)
 	, type(BVType::SPHERE)
+	, m_materialData(nullptr)
 	, local()
 	, material()
 {
@@ -15,6 +16,7 @@ SphereDebug::SphereDebug()
 SphereDebug::~SphereDebug()
 {
 	delete sphereMesh;
+	delete m_materialData;
 }
 
 void
@@ -147,7 +149,7 @@ void
 SphereDebug::draw(ShaderProgram* shaderProgram, Transform modelView)
 {
 	shaderProgram->setUniform ("hasBones", false);
-	material.setUniforms(shaderProgram);
+	material.setUniforms(shaderProgram, m_materialData);
 	if (type == BVType::SPHERE)
 	{
 		modelView.combine(local);
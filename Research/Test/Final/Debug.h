@@ -32,6 +32,8 @@ private:
 	Mesh* sphereMesh;
 	Mesh* boxMesh;
 	BVType type;
+	// Only created for shaders with a MaterialData block
+	UniformBuffer* m_materialData;
 public:
 
 	Transform local;
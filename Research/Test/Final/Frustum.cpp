@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "Frustum.h"
 
 /****************************************************************************************/
@@ -12,80 +14,47 @@ SphereBV::SphereBV()
 // BoxBV Class
 
 BoxBV::BoxBV()
-: points(NUM_POINTS)
+: points()
+, center()
+, extent()
+, axes(true)
 { }
 
 void
-BoxBV::init(std::vector<float>& lrbtnf)
+BoxBV::init(const std::vector<float>& lrbtnf)
 {
-	points[0] = Vector3(lrbtnf[0], lrbtnf[2], lrbtnf[4]);
-	points[1] = Vector3(lrbtnf[0], lrbtnf[2], lrbtnf[5]);
-	points[2] = Vector3(lrbtnf[0], lrbtnf[3], lrbtnf[4]);
-	points[3] = Vector3(lrbtnf[0], lrbtnf[3], lrbtnf[5]);
-	points[4] = Vector3(lrbtnf[1], lrbtnf[2], lrbtnf[4]);
-	points[5] = Vector3(lrbtnf[1], lrbtnf[2], lrbtnf[5]);
-	points[6] = Vector3(lrbtnf[1], lrbtnf[3], lrbtnf[4]);
-	points[7] = Vector3(lrbtnf[1], lrbtnf[3], lrbtnf[5]);
+	init(lrbtnf, Matrix3(true));
 }
 
 void
-BoxBV::init(std::vector<float>& lrbtnf, const Matrix3& rotation)
+BoxBV::init(const std::vector<float>& lrbtnf, const Matrix3& rotation)
 {
-	Vector3 point = 
-	{
-		lrbtnf[0], lrbtnf[2], lrbtnf[4]
-	};
-	point = rotation * point;
-	points[0] = point;
-
-	point = 
-	{
-		lrbtnf[0], lrbtnf[2], lrbtnf[5]
-	};
-	point = rotation * point;
-	points[1] = point;
-
-	point = 
-	{
-		lrbtnf[0], lrbtnf[3], lrbtnf[4]
-	};
-	point = rotation * point;
-	points[2] = point;
-
-	point = 
-	{
-		lrbtnf[0], lrbtnf[3], lrbtnf[5]
-	};
-	point = rotation * point;
-	points[3] = point;
-
-	point = 
+	// Corner n takes right when bit 2 is set, top for bit 1 and far for bit 0
+	for (unsigned n = 0; n < NUM_POINTS; ++n)
 	{
-		lrbtnf[1], lrbtnf[2], lrbtnf[4]
-	};
-	point = rotation * point;
-	points[4] = point;
-
-	point = 
-	{
-		lrbtnf[1], lrbtnf[2], lrbtnf[5]
-	};
-	point = rotation * point;
-	points[5] = point;
+		Vector3 point =
+		{
+			lrbtnf[ (n & 4) ? 1 : 0 ],
+			lrbtnf[ (n & 2) ? 3 : 2 ],
+			lrbtnf[ (n & 1) ? 5 : 4 ]
+		};
+		points[n] = rotation * point;
+	}
 
-	point = 
+	Vector3 localCenter =
 	{
-		lrbtnf[1], lrbtnf[3], lrbtnf[4]
+		0.5f * (lrbtnf[0] + lrbtnf[1]),
+		0.5f * (lrbtnf[2] + lrbtnf[3]),
+		0.5f * (lrbtnf[4] + lrbtnf[5])
 	};
-	point = rotation * point;
-	points[6] = point;
-	
-	point = 
+	center = rotation * localCenter;
+	extent =
 	{
-		lrbtnf[1], lrbtnf[3], lrbtnf[5]
+		0.5f * (lrbtnf[1] - lrbtnf[0]),
+		0.5f * (lrbtnf[3] - lrbtnf[2]),
+		0.5f * (lrbtnf[5] - lrbtnf[4])
 	};
-	point = rotation * point;
-	points[7] = point;
+	axes = rotation;
 }
 
 Vector3&
@@ -94,6 +63,12 @@ BoxBV::operator[] (unsigned n)
 	return points[n];
 }
 
+const Vector3&
+BoxBV::operator[] (unsigned n) const
+{
+	return points[n];
+}
+
 /****************************************************************************************/
 // Plane Class
 
@@ -117,7 +92,7 @@ Plane::normalize()
 }
 
 float
-Plane::dist(Vector3 point)
+Plane::dist(const Vector3& point) const
 {
 	return normal.dot(point) + d;
 }
@@ -148,8 +123,17 @@ Plane::printPlaneInfo(const std::string& planeName) const
 /****************************************************************************************/
 // Frustum Class
 
+Frustum::Frustum()
+: fPlanes()
+{
+	for (Plane& plane : fPlanes)
+	{
+		plane = { 0, 0, 0, 0 };
+	}
+}
+
 Frustum::Frustum(const Matrix4& MVP)
-: fPlanes(NUM_PLANES)
+: fPlanes()
 {
 	init(MVP);
 
@@ -216,7 +200,7 @@ Frustum::init(const Matrix4& MVP)
 
 // The normal is facing perpendicular outside of the Frustum
 bool
-Frustum::inFrustum(SphereBV& sphere)
+Frustum::inFrustum(const SphereBV& sphere) const
 {
 	for (unsigned i = 0; i < NUM_PLANES; ++i)
 	{
@@ -231,21 +215,14 @@ Frustum::inFrustum(SphereBV& sphere)
 	return true;
 }
 
+// Center and extent form of the p/n vertex test. The box is outside a plane
+// 	when even its reach toward the plane cannot get it in front of it.
 bool
-Frustum::inFrustum(BoxBV& box)
+Frustum::inFrustum(const BoxBV& box) const
 {
 	for (unsigned i = 0; i < NUM_PLANES; ++i)
 	{
-		unsigned outsideCount = 0;
-		for (unsigned j = 0; j < box.NUM_POINTS; ++j)
-		{
-			float distance = fPlanes[i].dist(box.points[j]);
-			if (distance < 0)
-			{
-				++outsideCount;
-			}
-		}
-		if (outsideCount == box.NUM_POINTS)
+		if (fPlanes[i].dist(box.center) < -reach(fPlanes[i], box))
 		{
 			return false;
 		}
@@ -253,6 +230,52 @@ Frustum::inFrustum(BoxBV& box)
 	return true;
 }
 
+Frustum::Containment
+Frustum::classify(const BoxBV& box, unsigned& activePlanes, unsigned char& lastRejected) const
+{
+	// Start at the plane that rejected the box last time, it usually still does
+	for (unsigned n = 0; n < NUM_PLANES; ++n)
+	{
+		unsigned i = (lastRejected + n) % NUM_PLANES;
+		if ((activePlanes & (1u << i)) == 0)
+		{
+			continue;
+		}
+		float boxReach = reach(fPlanes[i], box);
+		float distance = fPlanes[i].dist(box.center);
+		if (distance < -boxReach)
+		{
+			lastRejected = i;
+			return Containment::OUTSIDE;
+		}
+		if (distance >= boxReach)
+		{
+			activePlanes &= ~(1u << i);
+		}
+	}
+	return activePlanes == 0 ? Containment::INSIDE : Containment::INTERSECT;
+}
+
+float
+Frustum::reach(const Plane& plane, const BoxBV& box)
+{
+	return std::fabs(plane.normal.dot(box.axes.getRight())) 	* box.extent.x
+		+ std::fabs(plane.normal.dot(box.axes.getUp())) 		* box.extent.y
+		+ std::fabs(plane.normal.dot(box.axes.getBack())) 		* box.extent.z;
+}
+
+const Plane&
+Frustum::getPlane(unsigned index) const
+{
+	return fPlanes[index];
+}
+
+void
+Frustum::setPlane(unsigned index, const Plane& plane)
+{
+	fPlanes[index] = plane;
+}
+
 void
 Frustum::printFrustumInfo() const
 {
@@ -27,22 +27,33 @@ struct SphereBV
 	float radius;
 };
 
-// Axis Aligned Box
+// Axis Aligned or Oriented Box
+// Kept both as corners (for debug drawing) and as center, half extents
+// 	and axes, which is all the frustum test needs
 struct BoxBV
 {
 	BoxBV();
 
 	void
-	init(std::vector<float>& lrbtnf);
+	init(const std::vector<float>& lrbtnf);
 
+	// lrbtnf are limits in the rotated frame, rotation takes them back out
 	void
-	init(std::vector<float>& lrbtnf, const Matrix3& rotation);
+	init(const std::vector<float>& lrbtnf, const Matrix3& rotation);
 
 	Vector3&
 	operator[] (unsigned n);
 
-	std::vector<Vector3> points;
+	const Vector3&
+	operator[] (unsigned n) const;
+
 	static constexpr unsigned NUM_POINTS = 8;
+	Vector3 points[NUM_POINTS];
+	Vector3 center;
+	// Half size along each of the axes
+	Vector3 extent;
+	// Columns are the box's local x, y and z directions
+	Matrix3 axes;
 };
 
 struct Plane
@@ -58,7 +69,7 @@ struct Plane
 	normalize();
 
 	float
-	dist(Vector3 point);
+	dist(const Vector3& point) const;
 
 	Vector3
 	pointIntersection(Vector3& point, Vector3& direction);
@@ -74,23 +85,48 @@ class Frustum
 {
 public:
 
+	enum class Containment { OUTSIDE, INTERSECT, INSIDE };
+
+	// Every plane zeroed, nothing is culled until the planes are set
+	Frustum();
+
 	Frustum(const Matrix4& MVP);
 
 	void
 	init(const Matrix4& MVP);
 
 	bool
-	inFrustum(SphereBV& sphere);
+	inFrustum(const SphereBV& sphere) const;
 
 	bool
-	inFrustum(BoxBV& box);
+	inFrustum(const BoxBV& box) const;
+
+	// Hierarchical box test. Only planes whose bit is set in activePlanes are
+	// 	tested and the bits of planes the box is completely inside are cleared,
+	// 	so passing the result down lets children skip them. lastRejected is
+	// 	tested first and set to whichever plane rejects the box.
+	Containment
+	classify(const BoxBV& box, unsigned& activePlanes, unsigned char& lastRejected) const;
+
+	const Plane&
+	getPlane(unsigned index) const;
+
+	void
+	setPlane(unsigned index, const Plane& plane);
 
 	void
 	printFrustumInfo() const;
 
+	static constexpr unsigned NUM_PLANES 	= 6;
+	static constexpr unsigned ALL_PLANES 	= (1u << NUM_PLANES) - 1;
+
 private:
 
-	std::vector<Plane> fPlanes;
+	// How far the box extends toward the plane from its center
+	static float
+	reach(const Plane& plane, const BoxBV& box);
+
+	Plane fPlanes[NUM_PLANES];
 
 	static constexpr unsigned LEFT 			= 0;
 	static constexpr unsigned RIGHT 		= 1;
@@ -98,6 +134,4 @@ private:
 	static constexpr unsigned TOP 			= 3;
 	static constexpr unsigned NEAR 			= 4;
 	static constexpr unsigned FAR 			= 5;
-
-	static constexpr unsigned NUM_PLANES 	= 6;
 };
@@ -0,0 +1,279 @@
+#include "GLState.h"
+
+GLStateStats::GLStateStats()
+: programIssued(0)
+, vertexArrayIssued(0)
+, textureIssued(0)
+, bufferIssued(0)
+, elided(0)
+{ }
+
+unsigned
+GLStateStats::total() const
+{
+	return programIssued + vertexArrayIssued + textureIssued + bufferIssued + elided;
+}
+
+GLState::GLState()
+: m_program(0)
+, m_vertexArray(0)
+, m_activeUnit(0)
+, m_textures()
+, m_buffers()
+, m_uniformBases()
+, m_frame()
+, m_lastFrame()
+{ }
+
+void
+GLState::useProgram(GLuint program)
+{
+	if (program == m_program)
+	{
+		++m_frame.elided;
+		return;
+	}
+	glUseProgram ( program );
+	m_program = program;
+	++m_frame.programIssued;
+}
+
+void
+GLState::bindVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == m_vertexArray)
+	{
+		++m_frame.elided;
+		return;
+	}
+	glBindVertexArray ( vertexArray );
+	m_vertexArray = vertexArray;
+	m_buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	++m_frame.vertexArrayIssued;
+}
+
+void
+GLState::bindTexture(unsigned unit, GLuint texture)
+{
+	if (unit >= MAX_TEXTURE_UNITS)
+	{
+		glActiveTexture ( GL_TEXTURE0 + unit );
+		glBindTexture ( GL_TEXTURE_2D, texture );
+		m_activeUnit = unit;
+		m_frame.textureIssued += 2;
+		return;
+	}
+	if (texture == m_textures[unit])
+	{
+		++m_frame.elided;
+		return;
+	}
+	activeTexture(unit);
+	glBindTexture ( GL_TEXTURE_2D, texture );
+	m_textures[unit] = texture;
+	++m_frame.textureIssued;
+}
+
+void
+GLState::bindTexture(GLuint texture)
+{
+	bindTexture(m_activeUnit, texture);
+}
+
+void
+GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint& bound = m_buffers[bufferSlot(target)];
+	if (buffer == bound)
+	{
+		++m_frame.elided;
+		return;
+	}
+	glBindBuffer ( target, buffer );
+	bound = buffer;
+	++m_frame.bufferIssued;
+}
+
+void
+GLState::bindUniformBufferBase(GLuint index, GLuint buffer)
+{
+	if (index >= MAX_UNIFORM_BUFFER_BINDINGS)
+	{
+		glBindBufferBase ( GL_UNIFORM_BUFFER, index, buffer );
+		m_buffers[bufferSlot(GL_UNIFORM_BUFFER)] = buffer;
+		++m_frame.bufferIssued;
+		return;
+	}
+	if (buffer == m_uniformBases[index])
+	{
+		++m_frame.elided;
+		return;
+	}
+	glBindBufferBase ( GL_UNIFORM_BUFFER, index, buffer );
+	m_uniformBases[index] = buffer;
+	m_buffers[bufferSlot(GL_UNIFORM_BUFFER)] = buffer;
+	++m_frame.bufferIssued;
+}
+
+void
+GLState::unbindProgram()
+{
+	++m_frame.elided;
+}
+
+void
+GLState::unbindVertexArray()
+{
+	++m_frame.elided;
+}
+
+void
+GLState::unbindTexture(unsigned /*unit*/)
+{
+	++m_frame.elided;
+}
+
+void
+GLState::unbindBuffer(GLenum /*target*/)
+{
+	++m_frame.elided;
+}
+
+void
+GLState::deleteProgram(GLuint program)
+{
+	// A deleted program stays alive while it is in use
+	if (program == m_program)
+	{
+		glUseProgram ( 0 );
+		m_program = 0;
+		++m_frame.programIssued;
+	}
+	glDeleteProgram ( program );
+}
+
+void
+GLState::deleteVertexArray(GLuint vertexArray)
+{
+	glDeleteVertexArrays ( 1, &vertexArray );
+	if (vertexArray == m_vertexArray)
+	{
+		m_vertexArray = 0;
+		m_buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+}
+
+void
+GLState::deleteTexture(GLuint texture)
+{
+	glDeleteTextures ( 1, &texture );
+	for (GLuint& bound : m_textures)
+	{
+		if (bound == texture)
+		{
+			bound = 0;
+		}
+	}
+}
+
+void
+GLState::deleteBuffer(GLuint buffer)
+{
+	glDeleteBuffers ( 1, &buffer );
+	for (GLuint& bound : m_buffers)
+	{
+		if (bound == buffer)
+		{
+			bound = 0;
+		}
+	}
+	for (GLuint& bound : m_uniformBases)
+	{
+		if (bound == buffer)
+		{
+			bound = 0;
+		}
+	}
+}
+
+void
+GLState::invalidate()
+{
+	m_program = UNKNOWN;
+	m_vertexArray = UNKNOWN;
+	// Unit-less texture binds need a known unit, so pick one
+	glActiveTexture ( GL_TEXTURE0 );
+	m_activeUnit = 0;
+	++m_frame.textureIssued;
+	for (GLuint& bound : m_textures)
+	{
+		bound = UNKNOWN;
+	}
+	for (GLuint& bound : m_buffers)
+	{
+		bound = UNKNOWN;
+	}
+	for (GLuint& bound : m_uniformBases)
+	{
+		bound = UNKNOWN;
+	}
+}
+
+void
+GLState::beginFrame()
+{
+	m_lastFrame = m_frame;
+	m_frame = GLStateStats();
+}
+
+const GLStateStats&
+GLState::getLastFrameStats() const
+{
+	return m_lastFrame;
+}
+
+void
+GLState::printStats(std::ostream& out) const
+{
+	const GLStateStats& stats = m_lastFrame;
+	out << "GL state: " << stats.total() << " calls, "
+		<< stats.total() - stats.elided << " issued ("
+		<< stats.programIssued << " program, "
+		<< stats.vertexArrayIssued << " vertex array, "
+		<< stats.textureIssued << " texture, "
+		<< stats.bufferIssued << " buffer), "
+		<< stats.elided << " elided" << std::endl;
+}
+
+GLState&
+GLState::current()
+{
+	static GLState state;
+	return state;
+}
+
+unsigned
+GLState::bufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return 1;
+	case GL_UNIFORM_BUFFER:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+void
+GLState::activeTexture(unsigned unit)
+{
+	if (unit == m_activeUnit)
+	{
+		return;
+	}
+	glActiveTexture ( GL_TEXTURE0 + unit );
+	m_activeUnit = unit;
+	++m_frame.textureIssued;
+}
@@ -0,0 +1,136 @@
+/*
+  FileName    : GLState.h
+  Author      : Zachary Zuch
+  Description : Shadow copy of the GL binding state the engine touches, the
+  				program, vertex array, texture units and buffer bindings.
+  				Binds of what is already bound are dropped before reaching
+  				the driver and unbinds are left lazy, with counts of the
+  				issued and elided calls kept per frame.
+*/
+#pragma once
+
+#include <iostream>
+
+#include <GL/glew.h>
+
+struct GLStateStats
+{
+	GLStateStats();
+
+	unsigned
+	total() const;
+
+	unsigned programIssued;
+	unsigned vertexArrayIssued;
+	unsigned textureIssued;
+	unsigned bufferIssued;
+	unsigned elided;
+};
+
+class GLState
+{
+public:
+
+	// Matches a freshly created context, nothing bound
+	GLState();
+
+	// Disable copy ctor and copy assignment
+	GLState (const GLState&) = delete;
+	GLState& operator= (const GLState&) = delete;
+
+	void
+	useProgram(GLuint program);
+
+	void
+	bindVertexArray(GLuint vertexArray);
+
+	// Binds a GL_TEXTURE_2D on unit, switching the active unit if needed
+	void
+	bindTexture(unsigned unit, GLuint texture);
+
+	// Binds on whichever unit is active, for uploads
+	void
+	bindTexture(GLuint texture);
+
+	// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER or GL_UNIFORM_BUFFER
+	void
+	bindBuffer(GLenum target, GLuint buffer);
+
+	// Also binds the generic GL_UNIFORM_BUFFER target, like GL does
+	void
+	bindUniformBufferBase(GLuint index, GLuint buffer);
+
+	// Unbinds only count as elided. Whatever is left bound is replaced by
+	// 	the next bind, so only the calls that change what draws read remain.
+	void
+	unbindProgram();
+
+	void
+	unbindVertexArray();
+
+	void
+	unbindTexture(unsigned unit);
+
+	void
+	unbindBuffer(GLenum target);
+
+	// Delete and drop the object from the shadow, GL reuses deleted names
+	void
+	deleteProgram(GLuint program);
+
+	void
+	deleteVertexArray(GLuint vertexArray);
+
+	void
+	deleteTexture(GLuint texture);
+
+	void
+	deleteBuffer(GLuint buffer);
+
+	// Forget everything, for after GL calls made around this layer. The
+	// 	active texture unit is reset to 0 rather than forgotten.
+	void
+	invalidate();
+
+	// Keep the finished frame's counts and start counting the next
+	void
+	beginFrame();
+
+	const GLStateStats&
+	getLastFrameStats() const;
+
+	void
+	printStats(std::ostream& out = std::cout) const;
+
+	// The one context the engine renders with, GL thread only
+	static GLState&
+	current();
+
+	// Units past this are not shadowed and always issued
+	static constexpr unsigned MAX_TEXTURE_UNITS = 16;
+	static constexpr unsigned MAX_UNIFORM_BUFFER_BINDINGS = 16;
+
+private:
+
+	// Shadowed value that matches no GL name
+	static constexpr GLuint UNKNOWN = ~0u;
+
+	// Index of target's slot in m_buffers
+	static unsigned
+	bufferSlot(GLenum target);
+
+	void
+	activeTexture(unsigned unit);
+
+	GLuint m_program;
+	GLuint m_vertexArray;
+	unsigned m_activeUnit;
+	GLuint m_textures[MAX_TEXTURE_UNITS];
+	// Array, element array and uniform buffer targets. The element array
+	// 	binding belongs to the vertex array so it is unknown after a switch.
+	GLuint m_buffers[3];
+	GLuint m_uniformBases[MAX_UNIFORM_BUFFER_BINDINGS];
+
+	GLStateStats m_frame;
+	GLStateStats m_lastFrame;
+};
@@ -0,0 +1,82 @@
+#include <algorithm>
+
+#include "InstanceBuffer.h"
+#include "GLState.h"
+
+InstanceBuffer::InstanceBuffer()
+: m_vbo()
+, m_capacity(0)
+, m_data()
+{ }
+
+InstanceBuffer::~InstanceBuffer()
+{
+	if (m_capacity != 0)
+	{
+		GLState::current().deleteBuffer(m_vbo);
+	}
+}
+
+void
+InstanceBuffer::resize(unsigned count)
+{
+	m_data.resize(count * FLOATS_PER_INSTANCE);
+}
+
+void
+InstanceBuffer::set(unsigned index, const Transform& modelView, const Matrix3& normalMatrix)
+{
+	float* instance = &m_data[index * FLOATS_PER_INSTANCE];
+	modelView.getTransform(instance);
+	std::copy(normalMatrix.data(), normalMatrix.data() + 9, instance + 16);
+}
+
+unsigned
+InstanceBuffer::size() const
+{
+	return m_data.size() / FLOATS_PER_INSTANCE;
+}
+
+void
+InstanceBuffer::upload()
+{
+	const unsigned bytes = m_data.size() * sizeof(float);
+	if (m_capacity == 0)
+	{
+		glGenBuffers ( 1, &m_vbo );
+	}
+
+	GLState::current().bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	if (bytes > m_capacity)
+	{
+		m_capacity = bytes;
+	}
+	// Orphan last frame's storage so the driver never waits on it
+	glBufferData ( GL_ARRAY_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW );
+	glBufferSubData ( GL_ARRAY_BUFFER, 0, bytes, m_data.data() );
+	GLState::current().unbindBuffer(GL_ARRAY_BUFFER);
+}
+
+void
+InstanceBuffer::bindAttributes(unsigned firstInstance) const
+{
+	constexpr GLsizei STRIDE = FLOATS_PER_INSTANCE * sizeof(float);
+	const size_t base = firstInstance * STRIDE;
+
+	GLState::current().bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		glEnableVertexAttribArray 	(MODEL_VIEW_ATTRIB_INDEX + column);
+		glVertexAttribPointer 		(MODEL_VIEW_ATTRIB_INDEX + column, 4, GL_FLOAT, GL_FALSE, STRIDE,
+			reinterpret_cast<void*> (base + 4 * column * sizeof(float)));
+		glVertexAttribDivisor 		(MODEL_VIEW_ATTRIB_INDEX + column, 1);
+	}
+	for (GLuint column = 0; column < 3; ++column)
+	{
+		glEnableVertexAttribArray 	(NORMAL_MATRIX_ATTRIB_INDEX + column);
+		glVertexAttribPointer 		(NORMAL_MATRIX_ATTRIB_INDEX + column, 3, GL_FLOAT, GL_FALSE, STRIDE,
+			reinterpret_cast<void*> (base + (16 + 3 * column) * sizeof(float)));
+		glVertexAttribDivisor 		(NORMAL_MATRIX_ATTRIB_INDEX + column, 1);
+	}
+	GLState::current().unbindBuffer(GL_ARRAY_BUFFER);
+}
@@ -0,0 +1,60 @@
+/*
+  FileName    : InstanceBuffer.h
+  Author      : Zachary Zuch
+  Description : Per-instance vertex attributes for glDrawElementsInstanced.
+  				Each instance is its model view matrix followed by its normal
+  				matrix, read by Vec3Norm.vert when uInstanced is set.
+*/
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "Matrix3.h"
+#include "Transform.h"
+
+class InstanceBuffer
+{
+public:
+
+	InstanceBuffer();
+
+	~InstanceBuffer();
+
+	// Disable default copy ctor and copy assignment
+	InstanceBuffer (const InstanceBuffer&) = delete;
+	InstanceBuffer& operator= (const InstanceBuffer&) = delete;
+
+	// Number of instances in the CPU side copy
+	void
+	resize(unsigned count);
+
+	void
+	set(unsigned index, const Transform& modelView, const Matrix3& normalMatrix);
+
+	unsigned
+	size() const;
+
+	// Orphan the GL buffer and send the CPU side copy
+	void
+	upload();
+
+	// Point the instance attributes of the bound VAO at instances starting
+	// 	at firstInstance. GL 3.3 has no base instance so this is how one
+	// 	buffer serves several instanced draws.
+	// Precondition: the VAO to set up is bound
+	void
+	bindAttributes(unsigned firstInstance) const;
+
+	// Model view columns use locations 5 to 8, normal matrix columns 9 to 11
+	static constexpr GLuint MODEL_VIEW_ATTRIB_INDEX = 5;
+	static constexpr GLuint NORMAL_MATRIX_ATTRIB_INDEX = 9;
+	static constexpr unsigned FLOATS_PER_INSTANCE = 16 + 9;
+
+private:
+
+	GLuint m_vbo;
+	// Size of the GL buffer in bytes, it only grows
+	unsigned m_capacity;
+	std::vector<float> m_data;
+};
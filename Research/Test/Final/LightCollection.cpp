@@ -170,6 +170,19 @@ Light::setUniforms(ShaderProgram* shaderProgram, int index)
 	}
 }
 
+void
+Light::write(UniformBuffer& buffer, unsigned offset)
+{
+	// Scalars pack into the padding after attenuation
+	buffer.set(offset,		intensity.getDiffuse());
+	buffer.set(offset + 16,	intensity.getSpecular());
+	buffer.set(offset + 64,	m_attenuation);
+	buffer.set(offset + 76,	m_angleOfLight);
+	buffer.set(offset + 80,	m_falloff);
+	buffer.set(offset + 84,	static_cast<int> (m_isDirect));
+	buffer.set(offset + 88,	static_cast<int> (m_isActive));
+}
+
 LightCollection::LightCollection(unsigned numLights)
 : m_lights(numLights)
 { }
@@ -214,4 +227,29 @@ LightCollection::setUniforms(ShaderProgram* shaderProgram, Camera& camera)
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+void
+LightCollection::write(UniformBuffer& buffer, Camera& camera)
+{
+	for (unsigned i = 0; i < m_lights.size(); ++i)
+	{
+		const unsigned offset = i * Light::STD140_SIZE;
+		m_lights[i].write(buffer, offset);
+		if (m_lights[i].isActiveLight())
+		{
+			// Position and direction are in eye space
+			if (!m_lights[i].isDirectionalLight())
+			{
+				buffer.set(offset + 32, camera.getViewMatrix().translate(m_lights[i].position));
+			}
+			buffer.set(offset + 48, camera.getViewMatrix().getOrientation() * m_lights[i].direction);
+		}
+	}
+}
+
+unsigned
+LightCollection::std140Size()
+{
+	return m_lights.size() * Light::STD140_SIZE;
+}
@@ -2,6 +2,7 @@
 
 #include "ShaderProgram.h"
 #include "Camera.h"
+#include "UniformBuffer.h"
 #include <vector>
 
 class Intensity
@@ -85,6 +86,13 @@ public:
 	void
 	setUniforms(ShaderProgram* shaderProgram, int index);
 
+	// Fill the camera independent members of one std140 Light at offset
+	void
+	write(UniformBuffer& buffer, unsigned offset);
+
+	// Size of the std140 Light struct, the array stride in LightData
+	static constexpr unsigned STD140_SIZE = 6 * UniformBuffer::VEC4_SIZE;
+
 private:
 	
 	Vector3 m_attenuation;
@@ -116,6 +124,13 @@ public:
 	void
 	setUniforms(ShaderProgram* shaderProgram, Camera& camera);
 
+	// Fill a LightData std140 block, unchanged lights upload nothing
+	void
+	write(UniformBuffer& buffer, Camera& camera);
+
+	unsigned
+	std140Size();
+
 private:
 
 	std::vector<Light> m_lights;
@@ -32,6 +32,7 @@
 /******************************************************************/
 // Local includes
 #include "ShaderProgram.h"
+#include "GLState.h"
 #include "KeyBuffer.h"
 #include "Scene.h"
 
@@ -106,6 +107,16 @@ outputGlfwError (int error, const char* description);
 int
 main (int argc, char* argv[])
 {
+    // Spatial indices are only built on request, they cost a BSP build or
+    //      a cache read per model
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string (argv[i]) == "--spatial-index")
+        {
+            Model::setBuildSpatialIndex (true);
+        }
+    }
+
     GLFWwindow* window;
     init (window);
 
@@ -342,11 +353,7 @@ updateScene (double deltaTime)
     // couldnt figure out how to add text to the screen
     // std::cout << 1 / deltaTime << " fps" << std::flush;
 
-    Model* model = g_scene->models->getModel("model.dae");
-    if (model != nullptr)
-    {
-        model->m_bone->update(deltaTime * g_animationMultiplier);
-    }
+    g_scene->models->animate(deltaTime * g_animationMultiplier, g_scene->camera);
 }
 
 /******************************************************************/
@@ -354,6 +361,7 @@ updateScene (double deltaTime)
 void
 drawScene (GLFWwindow* window, double deltaTime)
 {
+    GLState::current().beginFrame();
     glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     unsigned numTriangles = g_scene->draw( g_shaderProgram );
@@ -437,18 +445,18 @@ recordKeys (GLFWwindow* window, int key, int scanCode, int action,
         if (key == GLFW_KEY_F7)
         {
             Model* model = g_scene->models->getModel("model.dae");
-            if (model != nullptr)
+            if (model != nullptr && model->getSkeleton() != nullptr)
             {
-                model->m_bone->bind.moveUp(1);
+                model->getSkeleton()->getBindPose(0).moveUp(1);
             }
         }
 
         if (key == GLFW_KEY_F8)
         {
             Model* model = g_scene->models->getModel("model.dae");
-            if (model != nullptr)
+            if (model != nullptr && model->getSkeleton() != nullptr)
             {
-                model->m_bone->bind.moveUp(-1);
+                model->getSkeleton()->getBindPose(0).moveUp(-1);
             }
         }
 
@@ -471,26 +479,26 @@ recordKeys (GLFWwindow* window, int key, int scanCode, int action,
         if (key == GLFW_KEY_F10)
         {
             Model* model = g_scene->models->getModel("model.dae");
-            if (model != nullptr)
+            if (model != nullptr && model->getSkeleton() != nullptr)
             {
-                model->m_bone->isAnimated = false;
+                model->getSkeleton()->setAnimated(false);
             }
         }
         if (key == GLFW_KEY_F11)
         {
             Model* model = g_scene->models->getModel("model.dae");
-            if (model != nullptr)
+            if (model != nullptr && model->getSkeleton() != nullptr)
             {
-                model->m_bone->isAnimated = true;
+                model->getSkeleton()->setAnimated(true);
             }
         }
              
         if (key == GLFW_KEY_F12)
         {
             Model* model = g_scene->models->getModel("model.dae");
-            if (model != nullptr)
+            if (model != nullptr && model->getSkeleton() != nullptr)
             {
-                model->m_bone->time = 0;
+                model->getSkeleton()->setTime(0.0f);
             }
         }
 
@@ -507,6 +515,34 @@ recordKeys (GLFWwindow* window, int key, int scanCode, int action,
             g_scene->setToAsymmetric(-0.075f, 0.125f, -0.075f, 0.125f, 0.1f, 120.0f);
         }
 
+        if ( key == GLFW_KEY_RIGHT_BRACKET && !g_scene->models->isEmpty() )
+        {
+            Model* model = g_scene->models->getActiveModel();
+            model->setInstanced(!model->isInstanced());
+        }
+
+        if ( key == GLFW_KEY_BACKSLASH )
+        {
+            std::cout << std::endl;
+            g_scene->models->getRenderQueue().printStats();
+            GLState::current().printStats();
+            g_scene->models->getPoseCache().printStats();
+            g_scene->models->getAnimationLod().printStats();
+            if (!g_scene->models->isEmpty())
+            {
+                g_scene->models->getActiveModel()->printBuildQuality(g_scene->camera);
+            }
+            for (unsigned i = 0; i < g_scene->models->numModel(); ++i)
+            {
+                Skeleton* skeleton = g_scene->models->getModel(i)->getSkeleton();
+                if (skeleton != nullptr && skeleton->getCompressedClip() != nullptr)
+                {
+                    std::cout << g_scene->models->getModel(i)->name << std::endl;
+                    skeleton->getCompressedClip()->printStats();
+                }
+            }
+        }
+
         if ( key == GLFW_KEY_MINUS )
         {
             g_scene->models->prev();
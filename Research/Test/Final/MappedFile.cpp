@@ -0,0 +1,102 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+: m_data(nullptr)
+, m_size(0)
+{ }
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool
+MappedFile::open(const std::string& fileName)
+{
+	close();
+
+	int descriptor = ::open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+	{
+		::close(descriptor);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// The mapping stays valid after the descriptor is closed
+	::close(descriptor);
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_data = static_cast<const unsigned char*>(mapping);
+	m_size = status.st_size;
+	return true;
+}
+
+void
+MappedFile::close()
+{
+	if (m_data != nullptr)
+	{
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+bool
+MappedFile::isOpen() const
+{
+	return m_data != nullptr;
+}
+
+const unsigned char*
+MappedFile::data() const
+{
+	return m_data;
+}
+
+size_t
+MappedFile::size() const
+{
+	return m_size;
+}
+
+uint64_t
+MappedFile::hash() const
+{
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+	uint64_t result = FNV_OFFSET_BASIS;
+	for (size_t i = 0; i < m_size; ++i)
+	{
+		result ^= m_data[i];
+		result *= FNV_PRIME;
+	}
+	return result;
+}
+
+uint64_t
+MappedFile::hashFile(const std::string& fileName)
+{
+	MappedFile file;
+	if (!file.open(fileName))
+	{
+		return 0;
+	}
+	return file.hash();
+}
@@ -0,0 +1,53 @@
+/*
+  FileName    : MappedFile.h
+  Author      : Zachary Zuch
+  Description : Read only memory mapping of a whole file plus the FNV-1a
+  				content hash used to tell when a cached build is stale.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+
+	MappedFile();
+
+	~MappedFile();
+
+	// Disable default copy ctor and copy assignment
+	MappedFile (const MappedFile&) = delete;
+	MappedFile& operator= (const MappedFile&) = delete;
+
+	// Returns false if the file is missing, empty or cannot be mapped
+	bool
+	open(const std::string& fileName);
+
+	void
+	close();
+
+	bool
+	isOpen() const;
+
+	const unsigned char*
+	data() const;
+
+	size_t
+	size() const;
+
+	// 64 bit FNV-1a of the mapped bytes
+	uint64_t
+	hash() const;
+
+	// Hash of fileName's contents, 0 if it cannot be read
+	static uint64_t
+	hashFile(const std::string& fileName);
+
+private:
+
+	const unsigned char* m_data;
+	size_t m_size;
+};
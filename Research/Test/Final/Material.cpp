@@ -28,4 +28,32 @@ Material::setUniforms(ShaderProgram* shaderProgram)
 	shaderProgram->setUniform("uMaterial.specularRefl", specularRefl);
 
 	shaderProgram->setUniform("uMaterial.shininess", 	shininess);
-}
\ No newline at end of file
+}
+
+void
+Material::setUniforms(ShaderProgram* shaderProgram, UniformBuffer*& buffer)
+{
+	if (shaderProgram->getUniformBlockIndex("MaterialData") == GL_INVALID_INDEX)
+	{
+		setUniforms(shaderProgram);
+		return;
+	}
+	if (buffer == nullptr)
+	{
+		buffer = new UniformBuffer(STD140_SIZE, BINDING);
+	}
+	write(*buffer);
+	buffer->upload();
+	shaderProgram->bindUniformBlock("MaterialData", BINDING);
+}
+
+void
+Material::write(UniformBuffer& buffer) const
+{
+	// Shininess packs into the last vec3's padding
+	buffer.set(0, 	ambientLight);
+	buffer.set(16, 	ambientRefl);
+	buffer.set(32, 	diffuseRefl);
+	buffer.set(48, 	specularRefl);
+	buffer.set(60, 	shininess);
+}
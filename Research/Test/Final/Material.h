@@ -2,6 +2,7 @@
 
 #include "Vector3.h"
 #include "ShaderProgram.h"
+#include "UniformBuffer.h"
 
 class Material
 {
@@ -17,6 +18,18 @@ public:
 	void
 	setUniforms(ShaderProgram* shaderProgram);
 
+	// Through the MaterialData std140 block when the shader declares one,
+	// 	buffer is created on first use and owned by the caller
+	void
+	setUniforms(ShaderProgram* shaderProgram, UniformBuffer*& buffer);
+
+	// Fill a MaterialData std140 block
+	void
+	write(UniformBuffer& buffer) const;
+
+	static constexpr unsigned STD140_SIZE = 4 * UniformBuffer::VEC4_SIZE;
+	static constexpr GLuint BINDING = 1;
+
 	// Ambient Light recieved from the material
 	Vector3 ambientLight;
 	// These are reflectances
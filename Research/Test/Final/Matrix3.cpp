@@ -6,6 +6,7 @@
 #include "Matrix3.h"
 #include "Vector3.h"
 #include "Math.h"
+#include "SymmetricEigen.h"
 
 // Basis vectors are stored in Vector3-s and form
 //   the columns of a 3x3 matrix. 
@@ -364,6 +365,22 @@ Matrix3::transform (const Vector3& v) const
 	return *this * v;
 }
 
+void
+Matrix3::symmetricEigen (Vector3& eigenValues, Matrix3& eigenVectors) const
+{
+	// Only the upper triangle is read
+	const float* m = data();
+	SymmetricEigen::Result3 result = SymmetricEigen::solve(m[0], m[3], m[6], m[4], m[7], m[8]);
+
+	eigenValues.set(result.values[0], result.values[1], result.values[2]);
+	eigenVectors.setMatrix3
+	(
+		result.vectors[0][0], result.vectors[0][1], result.vectors[0][2],
+		result.vectors[1][0], result.vectors[1][1], result.vectors[1][2],
+		result.vectors[2][0], result.vectors[2][1], result.vectors[2][2]
+	);
+}
+
 Matrix3&
 Matrix3::operator+= (const Matrix3& m)
 {
@@ -461,6 +478,16 @@ operator* (const Matrix3& m, const Vector3& v)
 	);
 }
 
+void
+symmetricEigen (const Matrix3* matrices, unsigned count,
+                Vector3* eigenValues, Matrix3* eigenVectors)
+{
+	for (unsigned i = 0; i < count; ++i)
+	{
+		matrices[i].symmetricEigen(eigenValues[i], eigenVectors[i]);
+	}
+}
+
 // Print "m" in a neat, tabular format using TWO digits
 //   of precision and a field width of 10 for each entry. 
 std::ostream&
@@ -130,6 +130,12 @@ public:
   Vector3
   transform (const Vector3& v) const;
 
+  // Eigen decomposition of this matrix, which must be symmetric.
+  // Eigenvalues are sorted largest first and the matching unit
+  //   eigenvectors become the right, up and back of eigenVectors.
+  void
+  symmetricEigen (Vector3& eigenValues, Matrix3& eigenVectors) const;
+
   Matrix3&
   operator+= (const Matrix3& m);
 
@@ -172,4 +178,9 @@ operator* (const Matrix3& m, const Vector3& v);
 std::ostream&
 operator<< (std::ostream& out, const Matrix3& m);
 
+// Matrix3::symmetricEigen over count matrices at once
+void
+symmetricEigen (const Matrix3* matrices, unsigned count,
+                Vector3* eigenValues, Matrix3* eigenVectors);
+
 #endif
\ No newline at end of file
@@ -6,10 +6,13 @@
   Description : This file is the mesh soure file which has the implementation
   				of the draw calls and vbo and vao creation and management.
 */
-#include <gsl/gsl_eigen.h>
 #include "Mesh.h"
+#include "GLState.h"
 #include "Matrix3.h"
 #include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
 
 // Initialize the mesh. Generate a VAO and VBO.
 Mesh::Mesh (const std::vector<float>& vertexData,  const std::vector<unsigned>& indices,
@@ -25,39 +28,80 @@ Mesh::Mesh (const std::vector<float>& vertexData,  const std::vector<unsigned>&
 , m_indices 		(indices)
 , m_boneWeights		(boneWeights)
 , m_boneIndices		(boneIndices)
+, m_positions		( )
+, m_numIndices		(indices.size())
+, m_numVertices		(vertexData.size() / FLOATS_PER_VERTEX)
+, isPrepared		(false)
+{ }
+
+Mesh::Mesh (std::vector<float>&& vertexData, std::vector<unsigned>&& indices,
+			const std::string&	texturePath,
+			std::vector<float>&& boneWeights, std::vector<unsigned>&& boneIndices)
+: textureFilePath(texturePath)
+, m_vao				( )
+, m_vbo 			( )
+, m_ibo				( )
+, m_vboBoneWeight	( )
+, m_vboBoneIndex	( )
+, m_vertexData		(std::move(vertexData))
+, m_indices 		(std::move(indices))
+, m_boneWeights		(std::move(boneWeights))
+, m_boneIndices		(std::move(boneIndices))
+, m_positions		( )
+, m_numIndices		(m_indices.size())
+, m_numVertices		(m_vertexData.size() / FLOATS_PER_VERTEX)
 , isPrepared		(false)
 { }
 
 // Free allocated resources. Delete generated VAO and VBO. 
 Mesh::~Mesh ()
+{
+	releaseVao();
+}
+
+void
+Mesh::releaseVao ()
 {
 	if (isPrepared)
 	{
-		glDeleteVertexArrays ( 1, &m_vao );
-		glDeleteBuffers ( 1, &m_vbo );
+		isPrepared = false;
+		GLState::current().deleteVertexArray(m_vao);
+		GLState::current().deleteBuffer(m_vbo);
 		if (!isBoneless())
 		{
-		 	glDeleteBuffers ( 1, &m_vboBoneWeight );
-			glDeleteBuffers ( 1, &m_vboBoneIndex );
+		 	GLState::current().deleteBuffer(m_vboBoneWeight);
+			GLState::current().deleteBuffer(m_vboBoneIndex);
 		}
-		glDeleteBuffers ( 1, &m_ibo );
+		GLState::current().deleteBuffer(m_ibo);
 	}
 }
 
+void
+Mesh::releaseGeometry ()
+{
+	std::vector<float>().swap(m_vertexData);
+	std::vector<unsigned>().swap(m_indices);
+	releasePositionStream();
+}
+
 void
 Mesh::addGeometry (const std::vector<float>& vertices, 
 	const std::vector<unsigned>& indices)
 {
+	// Indices refer to vertices, not floats
+	const unsigned baseVertex = numVertices();
 	unsigned beginSize = m_indices.size();
 	m_indices.insert(m_indices.end(), indices.begin(), indices.end());
-	if ( m_vertexData.size() != 0 )
+	if ( baseVertex != 0 )
 	{
 		for (unsigned i = beginSize; i < m_indices.size(); ++i)
 		{
-			m_indices[i] += m_vertexData.size();
+			m_indices[i] += baseVertex;
 		}	
 	}
 	m_vertexData.insert(m_vertexData.end(), vertices.begin(), vertices.end());
+	m_numIndices = m_indices.size();
+	m_numVertices = m_vertexData.size() / FLOATS_PER_VERTEX;
 }
 
 void
@@ -84,36 +128,21 @@ Mesh::prepareVao ()
 
 	isPrepared = true;
 
-	constexpr GLint POSITION_ATTRIB_INDEX = 0;
-  	constexpr GLint NORMAL_ATTRIB_INDEX = 1;
-  	constexpr GLint TEXCOORD_ATTRIB_INDEX = 2;
   	constexpr GLint BONE_WEIGHT_ATTRIB_INDEX = 3;
   	constexpr GLint BONE_INDEX_ATTRIB_INDEX = 4;
 
-	glBindVertexArray ( m_vao );
+	GLState& state = GLState::current();
+	state.bindVertexArray(m_vao);
 
-	glBindBuffer ( GL_ARRAY_BUFFER, m_vbo );
+	state.bindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBufferData ( GL_ARRAY_BUFFER, m_vertexData.size() * sizeof(float),
 		m_vertexData.data(), GL_STATIC_DRAW );
-
-	glEnableVertexAttribArray (POSITION_ATTRIB_INDEX);
-	glVertexAttribPointer (POSITION_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 
-		FLOATS_PER_VERTEX * sizeof(float), reinterpret_cast<void*> (0));
-
-	glEnableVertexAttribArray (NORMAL_ATTRIB_INDEX);
- 	glVertexAttribPointer (NORMAL_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 
- 		FLOATS_PER_VERTEX * sizeof(float), 
- 		reinterpret_cast<void*> ( 3 * sizeof(float)));
-
- 	glEnableVertexAttribArray (TEXCOORD_ATTRIB_INDEX);
- 	glVertexAttribPointer (TEXCOORD_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, 
- 		FLOATS_PER_VERTEX * sizeof(float), 
- 		reinterpret_cast<void*> ( 6 * sizeof(float)));
+	setVertexAttributes ();
 
 	if (!isBoneless())
 	{
 		// Buffer Bone Weights
-		glBindBuffer ( GL_ARRAY_BUFFER, m_vboBoneWeight );
+		state.bindBuffer(GL_ARRAY_BUFFER, m_vboBoneWeight);
 	 	glBufferData ( GL_ARRAY_BUFFER, m_boneWeights.size() * sizeof(float),
 			m_boneWeights.data(), GL_STATIC_DRAW );
 
@@ -122,7 +151,7 @@ Mesh::prepareVao ()
 	 		NUM_BONE_INDICES * sizeof(float), reinterpret_cast<void*> (0));
 
 	 	// Buffer Bone Indices
-	 	glBindBuffer ( GL_ARRAY_BUFFER, m_vboBoneIndex );
+	 	state.bindBuffer(GL_ARRAY_BUFFER, m_vboBoneIndex);
 	 	glBufferData ( GL_ARRAY_BUFFER, m_boneIndices.size() * sizeof(unsigned),
 			m_boneIndices.data(), GL_STATIC_DRAW );
 
@@ -131,33 +160,158 @@ Mesh::prepareVao ()
 	 		NUM_BONE_INDICES * sizeof(float), reinterpret_cast<void*> (0));
 	}
 		
- 	glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, m_ibo );
+ 	state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
 	glBufferData ( GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned),
 		m_indices.data(), GL_STATIC_DRAW );
 
-	glBindVertexArray (0);
+	state.unbindVertexArray();
+}
+
+// Point position, normal and texture coordinate at the bound array buffer
+void
+Mesh::setVertexAttributes ()
+{
+	constexpr GLint POSITION_ATTRIB_INDEX = 0;
+  	constexpr GLint NORMAL_ATTRIB_INDEX = 1;
+  	constexpr GLint TEXCOORD_ATTRIB_INDEX = 2;
+
+	glEnableVertexAttribArray (POSITION_ATTRIB_INDEX);
+	glVertexAttribPointer (POSITION_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 
+		FLOATS_PER_VERTEX * sizeof(float), reinterpret_cast<void*> (0));
+
+	glEnableVertexAttribArray (NORMAL_ATTRIB_INDEX);
+ 	glVertexAttribPointer (NORMAL_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 
+ 		FLOATS_PER_VERTEX * sizeof(float), 
+ 		reinterpret_cast<void*> ( 3 * sizeof(float)));
+
+ 	glEnableVertexAttribArray (TEXCOORD_ATTRIB_INDEX);
+ 	glVertexAttribPointer (TEXCOORD_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, 
+ 		FLOATS_PER_VERTEX * sizeof(float), 
+ 		reinterpret_cast<void*> ( 6 * sizeof(float)));
+}
+
+void
+Mesh::setVertexBuffer (GLuint vertexBuffer)
+{
+	GLState& state = GLState::current();
+	state.bindVertexArray(m_vao);
+	state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer == 0 ? m_vbo : vertexBuffer);
+	setVertexAttributes ();
+	state.unbindVertexArray();
 }
 
 // Precondition: Shader Program is enabled and uniforms are set
 void
 Mesh::draw()
 {
-	glBindVertexArray( m_vao );
-	glDrawElements ( GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 
+	GLState::current().bindVertexArray(m_vao);
+	glDrawElements ( GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 
 		reinterpret_cast<void*> (0));
-	glBindVertexArray(0);
+	GLState::current().unbindVertexArray();
+}
+
+// Precondition: Shader Program is enabled and uniforms are set
+void
+Mesh::draw(unsigned firstIndex, unsigned count)
+{
+	GLState::current().bindVertexArray(m_vao);
+	glDrawElements ( GL_TRIANGLES, count, GL_UNSIGNED_INT,
+		reinterpret_cast<void*> (firstIndex * sizeof(unsigned)));
+	GLState::current().unbindVertexArray();
+}
+
+// Precondition: Shader Program is enabled and uniforms are set
+void
+Mesh::draw(const IndexRange* ranges, unsigned numRanges)
+{
+	if (numRanges == 1)
+	{
+		draw(ranges[0].first, ranges[0].count);
+		return;
+	}
+	std::vector<GLsizei> counts(numRanges);
+	std::vector<const void*> offsets(numRanges);
+	for (unsigned i = 0; i < numRanges; ++i)
+	{
+		counts[i] = ranges[i].count;
+		offsets[i] = reinterpret_cast<const void*> (ranges[i].first * sizeof(unsigned));
+	}
+	GLState::current().bindVertexArray(m_vao);
+	glMultiDrawElements ( GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), numRanges );
+	GLState::current().unbindVertexArray();
+}
+
+// Precondition: Shader Program is enabled and uniforms are set
+void
+Mesh::drawInstanced(const InstanceBuffer& instances, unsigned firstInstance, unsigned instanceCount)
+{
+	drawInstanced(instances, firstInstance, instanceCount, { 0, m_numIndices });
+}
+
+// Precondition: Shader Program is enabled and uniforms are set
+void
+Mesh::drawInstanced(const InstanceBuffer& instances, unsigned firstInstance, unsigned instanceCount,
+	const IndexRange& range)
+{
+	GLState::current().bindVertexArray(m_vao);
+	instances.bindAttributes(firstInstance);
+	glDrawElementsInstanced ( GL_TRIANGLES, range.count, GL_UNSIGNED_INT,
+		reinterpret_cast<void*> (range.first * sizeof(unsigned)), instanceCount );
+	GLState::current().unbindVertexArray();
 }
 
 unsigned
 Mesh::numIndices() const
 {
-	return m_indices.size();
+	return m_numIndices;
 }
 
 unsigned
 Mesh::numVertices() const
 {
-	return m_vertexData.size() / FLOATS_PER_VERTEX;
+	return m_numVertices;
+}
+
+const std::vector<float>&
+Mesh::getVertexData() const
+{
+	return m_vertexData;
+}
+
+const std::vector<unsigned>&
+Mesh::getIndices() const
+{
+	return m_indices;
+}
+
+const std::vector<float>&
+Mesh::getBoneWeights() const
+{
+	return m_boneWeights;
+}
+
+const std::vector<unsigned>&
+Mesh::getBoneIndices() const
+{
+	return m_boneIndices;
+}
+
+void
+Mesh::buildPositionStream()
+{
+	m_positions.init(m_vertexData, FLOATS_PER_VERTEX);
+}
+
+void
+Mesh::releasePositionStream()
+{
+	m_positions.clear();
+}
+
+bool
+Mesh::hasPositionStream() const
+{
+	return !m_positions.isEmpty();
 }
 
 bool
@@ -181,6 +335,11 @@ Mesh::hasTexture() const
 Vector3
 Mesh::getMeshCenter() const
 {
+	if (hasPositionStream())
+	{
+		return m_positions.sum() / m_positions.size();
+	}
+
 	Vector3 sum;
 	unsigned n;
 	for ( n = 0; n * FLOATS_PER_VERTEX < m_vertexData.size(); ++n )
@@ -198,6 +357,16 @@ Mesh::getMeshCenter() const
 void
 Mesh::getRadius(SphereBV& sphere)
 {
+	if (hasPositionStream())
+	{
+		float radius = m_positions.getMaxDistance(sphere.center);
+		if ( radius > sphere.radius )
+		{
+			sphere.radius = radius;
+		}
+		return;
+	}
+
 	for ( unsigned n = 0; n * FLOATS_PER_VERTEX < m_vertexData.size(); ++n )
 	{
 		Vector3 vertexDistance( m_vertexData[ FLOATS_PER_VERTEX * n     ],	// x
@@ -217,6 +386,14 @@ Mesh::getRadius(SphereBV& sphere)
 void
 Mesh::getBoxBV(std::vector<float>& lrbtnf)
 {
+	if (hasPositionStream())
+	{
+		Vector3 min, max;
+		m_positions.getBounds(min, max);
+		mergeBoxLimits(lrbtnf, min, max);
+		return;
+	}
+
 	unsigned n = 0;
 
 	if (lrbtnf.size() == 0)
@@ -255,6 +432,14 @@ Mesh::getBoxBV(std::vector<float>& lrbtnf)
 void
 Mesh::getBoxBV(std::vector<float>& lrbtnf, const Matrix3& rotation)
 {
+	if (hasPositionStream())
+	{
+		Vector3 min, max;
+		m_positions.getBounds(min, max, rotation);
+		mergeBoxLimits(lrbtnf, min, max);
+		return;
+	}
+
 	unsigned n = 0;
 	Vector3 point;
 
@@ -300,30 +485,42 @@ Mesh::getBoxBV(std::vector<float>& lrbtnf, const Matrix3& rotation)
 	}
 }
 
-Matrix3
-Mesh::getCovarianceMatrix(const Vector3& mean, Matrix3& covarianceMatrix)
+Moments
+Mesh::getMoments() const
 {
-	constexpr unsigned MATRIX_MAX = 3;
-	for (unsigned i = 0; i < MATRIX_MAX; ++i)
+	return getMoments(0, numVertices());
+}
+
+Moments
+Mesh::getMoments(unsigned first, unsigned count) const
+{
+	Moments moments;
+	unsigned end = first + count;
+	if (end > numVertices()) end = numVertices();
+
+	if (hasPositionStream())
 	{
-		for (unsigned j = 0; j < MATRIX_MAX; ++j)
-		{
-			unsigned n = 0;
-			for (; n * FLOATS_PER_VERTEX < m_vertexData.size(); ++n)
-			{
-				covarianceMatrix.getValue(i, j) += 
-					((mean[i] - m_vertexData[ FLOATS_PER_VERTEX * n + i ]) * 
-					 (mean[j] - m_vertexData[ FLOATS_PER_VERTEX * n + j ]));
-			}
-			covarianceMatrix.getValue(i, j) /= (n - 1);
-		}
+		m_positions.accumulate(moments, first, end);
+		return moments;
+	}
+
+	for (unsigned n = first; n < end; ++n)
+	{
+		moments.add(m_vertexData[ FLOATS_PER_VERTEX * n     ],
+					m_vertexData[ FLOATS_PER_VERTEX * n + 1 ],
+					m_vertexData[ FLOATS_PER_VERTEX * n + 2 ]);
 	}
-	return covarianceMatrix;
+	return moments;
 }
 
 Vector3
 Mesh::getMassSum()
 {
+	if (hasPositionStream())
+	{
+		return m_positions.sum();
+	}
+
 	Vector3 sum = { 0, 0, 0 };
 	for ( unsigned n = 0; n * FLOATS_PER_VERTEX < m_vertexData.size(); ++n )
 	{
@@ -334,523 +531,202 @@ Mesh::getMassSum()
 	return sum;
 }
 
+// Grow lrbtnf to contain min and max, initializing it when empty
+void
+Mesh::mergeBoxLimits(std::vector<float>& lrbtnf, const Vector3& min, const Vector3& max)
+{
+	if (lrbtnf.size() == 0)
+	{
+		lrbtnf = { min.x, max.x, min.y, max.y, min.z, max.z };
+		return;
+	}
+
+	if ( min.x < lrbtnf[0] ) lrbtnf[0] = min.x;
+	if ( max.x > lrbtnf[1] ) lrbtnf[1] = max.x;
+	if ( min.y < lrbtnf[2] ) lrbtnf[2] = min.y;
+	if ( max.y > lrbtnf[3] ) lrbtnf[3] = max.y;
+	if ( min.z < lrbtnf[4] ) lrbtnf[4] = min.z;
+	if ( max.z > lrbtnf[5] ) lrbtnf[5] = max.z;
+}
+
+namespace
+{
+	// Geometry gathered for one side of a split
+	struct SplitSide
+	{
+		std::vector<float> 		vertexData;
+		std::vector<unsigned> 	indices;
+		std::vector<float> 		boneWeights;
+		std::vector<unsigned> 	boneIndices;
+	};
+
+	constexpr unsigned NOT_MAPPED = ~0u;
+}
+
 // first  = front
 // second = back
+// Vertices on the plane count as front. Each original vertex is copied at
+// 	most once through a dense remap table and each cut edge is interpolated
+// 	once through a hash map, so the split is O(V + T). Only locals are written
+// 	so independent meshes can be split on different threads.
 std::pair<Mesh*, Mesh*>
-Mesh::split(Plane& splitter)
+Mesh::split(const Plane& splitter) const
 {
-	std::vector<float> 		frontVertexData;
-	std::vector<unsigned> 	frontOldIndices;
-	std::vector<unsigned> 	frontIndices;
-
-	std::vector<float> 		backVertexData;
-	std::vector<unsigned> 	backOldIndices;
-	std::vector<unsigned> 	backIndices;
-
-	Vector3 temp;
+	const unsigned vertexCount = numVertices();
+	const bool hasBones = !isBoneless();
 
-	for (unsigned numVertex = 0; numVertex * FLOATS_PER_VERTEX < m_vertexData.size(); ++numVertex)
+	std::vector<float> distances(vertexCount);
+	for (unsigned n = 0; n < vertexCount; ++n)
 	{
-		temp = 
-		{
-			m_vertexData[ FLOATS_PER_VERTEX * numVertex     ],
-			m_vertexData[ FLOATS_PER_VERTEX * numVertex + 1 ],
-			m_vertexData[ FLOATS_PER_VERTEX * numVertex + 2 ]
-		};
-
-		if (splitter.dist(temp) >= 0)
+		distances[n] = splitter.dist(
 		{
-			frontVertexData.insert(frontVertexData.end(), 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex     ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 1 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 2 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 3 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 4 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 5 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 6 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 7 ]
-			});
-			frontOldIndices.push_back(numVertex);
-		}
-		else
-		{
-			backVertexData.insert(backVertexData.end(), 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex     ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 1 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 2 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 3 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 4 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 5 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 6 ],
-				m_vertexData[ FLOATS_PER_VERTEX * numVertex + 7 ]
-			});
-			backOldIndices.push_back(numVertex);
-		}
-		// Calculate new indices and clip and make new vertices and indices
+			m_vertexData[ FLOATS_PER_VERTEX * n     ],
+			m_vertexData[ FLOATS_PER_VERTEX * n + 1 ],
+			m_vertexData[ FLOATS_PER_VERTEX * n + 2 ]
+		});
 	}
 
-	/*for (unsigned A : frontOldIndices)
-	{
-		std::cout << A << " ";
-	}
-	std::cout << std::endl;
+	SplitSide sides[2];
+	// Old vertex index -> index on the side the vertex is on
+	std::vector<unsigned> remap(vertexCount, NOT_MAPPED);
+	// Cut edge (low index << 32 | high index) -> new index on front and back
+	std::unordered_map<uint64_t, std::pair<unsigned, unsigned>> cutEdges;
 
-	for (unsigned A : backOldIndices)
+	auto copyBones = [&](SplitSide& side, unsigned vertex)
 	{
-		std::cout << A << " ";
-	}
-	std::cout << std::endl;*/
-
-	constexpr unsigned INDICES_PER_TRIANGLE = 3; 
-	for (unsigned numTriangles = 0; numTriangles * INDICES_PER_TRIANGLE < m_indices.size(); ++numTriangles)
+		side.boneWeights.insert(side.boneWeights.end(),
+			m_boneWeights.begin() + NUM_BONE_INDICES * vertex,
+			m_boneWeights.begin() + NUM_BONE_INDICES * (vertex + 1));
+		side.boneIndices.insert(side.boneIndices.end(),
+			m_boneIndices.begin() + NUM_BONE_INDICES * vertex,
+			m_boneIndices.begin() + NUM_BONE_INDICES * (vertex + 1));
+	};
+
+	auto getVertex = [&](unsigned vertex)
 	{
-		unsigned A = m_indices[ INDICES_PER_TRIANGLE * numTriangles     ];
-		unsigned B = m_indices[ INDICES_PER_TRIANGLE * numTriangles + 1 ];
-		unsigned C = m_indices[ INDICES_PER_TRIANGLE * numTriangles + 2 ];
-
-		// Improve search algorithm
-		std::pair<bool, unsigned> isAFront = isIn(frontOldIndices, A);
-		std::pair<bool, unsigned> isBFront = isIn(frontOldIndices, B);
-		std::pair<bool, unsigned> isCFront = isIn(frontOldIndices, C);
-
-		bool isAllFront =   isAFront.first  &&   isBFront.first  &&   isCFront.first;
-		bool isAllBack  = (!isAFront.first) && (!isBFront.first) && (!isCFront.first);
-
-		if (isAllFront)
+		SplitSide& side = sides[ distances[vertex] >= 0 ? 0 : 1 ];
+		if (remap[vertex] == NOT_MAPPED)
 		{
-			frontIndices.insert(frontIndices.end(), 
-			{
-				isAFront.second,
-				isBFront.second,
-				isCFront.second
-			});
+			remap[vertex] = side.vertexData.size() / FLOATS_PER_VERTEX;
+			side.vertexData.insert(side.vertexData.end(),
+				m_vertexData.begin() + FLOATS_PER_VERTEX * vertex,
+				m_vertexData.begin() + FLOATS_PER_VERTEX * (vertex + 1));
+			if (hasBones) copyBones(side, vertex);
 		}
-		else if (isAllBack)
+		return remap[vertex];
+	};
+
+	// The new vertex is shared by both sides
+	auto getCutVertex = [&](unsigned a, unsigned b)
+	{
+		// Always interpolate from the lower index so both triangles sharing
+		// 	the edge produce the identical vertex
+		if (b < a) std::swap(a, b);
+		const uint64_t key = (static_cast<uint64_t>(a) << 32) | b;
+		auto found = cutEdges.find(key);
+		if (found != cutEdges.end())
 		{
-			std::pair<bool, unsigned> isABack = isIn(backOldIndices, A);
-			std::pair<bool, unsigned> isBBack = isIn(backOldIndices, B);
-			std::pair<bool, unsigned> isCBack = isIn(backOldIndices, C);
+			return found->second;
+		}
 
-			backIndices.insert(backIndices.end(), 
-			{
-				isABack.second,
-				isBBack.second,
-				isCBack.second
-			});
+		const float t = distances[a] / (distances[a] - distances[b]);
+		float vertex[FLOATS_PER_VERTEX];
+		for (unsigned i = 0; i < FLOATS_PER_VERTEX; ++i)
+		{
+			float start = m_vertexData[ FLOATS_PER_VERTEX * a + i ];
+			float end   = m_vertexData[ FLOATS_PER_VERTEX * b + i ];
+			vertex[i] = start + (end - start) * t;
 		}
-		else
+		Vector3 normal(vertex[3], vertex[4], vertex[5]);
+		if (normal.length() > 0)
 		{
-			// Split Polygon Case
-
-			// Vertex Positions
+			normal.normalize();
+			vertex[3] = normal.x;
+			vertex[4] = normal.y;
+			vertex[5] = normal.z;
+		}
 
-			// ORDER : A -> B -> C
-			Vector3 aPosition = 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * A     ],
-				m_vertexData[ FLOATS_PER_VERTEX * A + 1 ],
-				m_vertexData[ FLOATS_PER_VERTEX * A + 2 ]
-			};
-			Vector3 normalA = 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * A + 3 ],
-				m_vertexData[ FLOATS_PER_VERTEX * A + 4 ],
-				m_vertexData[ FLOATS_PER_VERTEX * A + 5 ]
-			};
+		std::pair<unsigned, unsigned> newIndices;
+		unsigned* sideIndex = &newIndices.first;
+		for (SplitSide& side : sides)
+		{
+			*sideIndex = side.vertexData.size() / FLOATS_PER_VERTEX;
+			side.vertexData.insert(side.vertexData.end(), vertex, vertex + FLOATS_PER_VERTEX);
+			// Bone indices cannot be blended so take the nearer end point's
+			if (hasBones) copyBones(side, t < 0.5f ? a : b);
+			sideIndex = &newIndices.second;
+		}
+		cutEdges.emplace(key, newIndices);
+		return newIndices;
+	};
 
-			Vector3 bPosition = 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * B     ],
-				m_vertexData[ FLOATS_PER_VERTEX * B + 1 ],
-				m_vertexData[ FLOATS_PER_VERTEX * B + 2 ]
-			};
-			Vector3 normalB = 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * B + 3 ],
-				m_vertexData[ FLOATS_PER_VERTEX * B + 4 ],
-				m_vertexData[ FLOATS_PER_VERTEX * B + 5 ]
-			};
+	constexpr unsigned INDICES_PER_TRIANGLE = 3;
+	for (unsigned first = 0; first + INDICES_PER_TRIANGLE <= m_indices.size(); first += INDICES_PER_TRIANGLE)
+	{
+		const unsigned corners[INDICES_PER_TRIANGLE] =
+		{
+			m_indices[ first     ],
+			m_indices[ first + 1 ],
+			m_indices[ first + 2 ]
+		};
+		const bool isFront[INDICES_PER_TRIANGLE] =
+		{
+			distances[ corners[0] ] >= 0,
+			distances[ corners[1] ] >= 0,
+			distances[ corners[2] ] >= 0
+		};
 
-			Vector3 cPosition = 
-			{
-				m_vertexData[ FLOATS_PER_VERTEX * C     ],
-				m_vertexData[ FLOATS_PER_VERTEX * C + 1 ],
-				m_vertexData[ FLOATS_PER_VERTEX * C + 2 ]
-			};
-			Vector3 normalC = 
+		if (isFront[0] == isFront[1] && isFront[1] == isFront[2])
+		{
+			SplitSide& side = sides[ isFront[0] ? 0 : 1 ];
+			for (unsigned corner : corners)
 			{
-				m_vertexData[ FLOATS_PER_VERTEX * C + 3 ],
-				m_vertexData[ FLOATS_PER_VERTEX * C + 4 ],
-				m_vertexData[ FLOATS_PER_VERTEX * C + 5 ]
-			};
+				side.indices.push_back(getVertex(corner));
+			}
+			continue;
+		}
 
-			if (isAFront.first)
+		// Sutherland-Hodgman against the plane, the triangle becomes a
+		// 	triangle on one side and a quad on the other
+		unsigned frontPolygon[4], backPolygon[4];
+		unsigned frontCount = 0, backCount = 0;
+		for (unsigned i = 0; i < INDICES_PER_TRIANGLE; ++i)
+		{
+			const unsigned j = (i + 1) % INDICES_PER_TRIANGLE;
+			if (isFront[i])
 			{
-				// C is solo on the back
-				if (isBFront.first)
-				{
-					std::pair<bool, unsigned> isCBack = isIn(backOldIndices, C);
-					Vector3 CtoA = aPosition;
-					CtoA 		-= cPosition;
-					Vector3 CtoB = bPosition;
-					CtoB 		-= cPosition;
-
-					Vector3 CtoAPoint = splitter.pointIntersection(cPosition, CtoA);
-					Vector3 CtoBPoint = splitter.pointIntersection(cPosition, CtoB);
-
-					Vector3 scaleCA = CtoAPoint - cPosition;
-					scaleCA /= CtoA;
-					Vector3 newNormalCA = normalC.linearInterpolation(normalA, scaleCA);
-
-					Vector3 scaleCB = CtoBPoint - cPosition;
-					scaleCB /= CtoB;
-					Vector3 newNormalCB = normalC.linearInterpolation(normalB, scaleCB); 
-
-					// BACK
-					backIndices.insert(backIndices.end(), 
-					{
-						static_cast<unsigned>( backVertexData.size() ),
-						static_cast<unsigned>( backVertexData.size() + 1 ),
-						isCBack.second
-					});
-
-					backVertexData.insert(backVertexData.end(), 
-					{
-						CtoAPoint.x, CtoAPoint.y, CtoAPoint.z, newNormalCA.x, newNormalCA.y, newNormalCA.z, 0, 0,
-						CtoBPoint.x, CtoBPoint.y, CtoBPoint.z, newNormalCB.x, newNormalCB.y, newNormalCB.z, 0, 0
-					});
-
-					// FRONT
-					frontIndices.insert(frontIndices.end(), 
-					{
-						// Triangle 1
-						isAFront.second,
-						isBFront.second,
-						static_cast<unsigned>( frontVertexData.size() ),
-
-						// Triangle 2
-						static_cast<unsigned>( frontVertexData.size() ),
-						isBFront.second,
-						static_cast<unsigned>( frontVertexData.size() + 1 )
-					});
-					frontVertexData.insert(frontVertexData.end(), 
-					{
-						CtoAPoint.x, CtoAPoint.y, CtoAPoint.z, newNormalCA.x, newNormalCA.y, newNormalCA.z, 0, 0,
-						CtoBPoint.x, CtoBPoint.y, CtoBPoint.z, newNormalCB.x, newNormalCB.y, newNormalCB.z, 0, 0
-					});
-				}
-				// B is solo on Back
-				else if (isCFront.first)
-				{
-					std::pair<bool, unsigned> isBBack = isIn(backOldIndices, B);
-					Vector3 BtoA = aPosition;
-					BtoA 		-= bPosition;
-					Vector3 BtoC = cPosition;
-					BtoC 		-= bPosition;
-
-					Vector3 BtoAPoint = splitter.pointIntersection(bPosition, BtoA);
-					Vector3 BtoCPoint = splitter.pointIntersection(bPosition, BtoC);
-
-					Vector3 scaleBA = BtoAPoint - bPosition;
-					scaleBA /= BtoA;
-					Vector3 newNormalBA = normalB.linearInterpolation(normalA, scaleBA);
-
-					Vector3 scaleBC = BtoCPoint - bPosition;
-					scaleBC /= BtoC;
-					Vector3 newNormalBC = normalB.linearInterpolation(normalC, scaleBC);
-
-					// BACK
-					backIndices.insert(backIndices.end(), 
-					{
-						static_cast<unsigned>( backVertexData.size() ),
-						isBBack.second,
-						static_cast<unsigned>( backVertexData.size() + 1 )
-					});
-					backVertexData.insert(backVertexData.end(), 
-					{
-						BtoAPoint.x, BtoAPoint.y, BtoAPoint.z, newNormalBA.x, newNormalBA.y, newNormalBA.z, 0, 0,
-						BtoCPoint.x, BtoCPoint.y, BtoCPoint.z, newNormalBC.x, newNormalBC.y, newNormalBC.z, 0, 0
-					});
-
-					// FRONT
-					frontIndices.insert(frontIndices.end(), 
-					{
-						// Triangle 1
-						isAFront.second,
-						static_cast<unsigned>( frontVertexData.size() ),
-						isCFront.second,
-
-						// Triangle 2
-						static_cast<unsigned>( frontVertexData.size() ),
-						static_cast<unsigned>( frontVertexData.size() + 1 ),
-						isCFront.second
-					});
-					frontVertexData.insert(frontVertexData.end(), 
-					{
-						BtoAPoint.x, BtoAPoint.y, BtoAPoint.z, newNormalBA.x, newNormalBA.y, newNormalBA.z, 0, 0,
-						BtoCPoint.x, BtoCPoint.y, BtoCPoint.z, newNormalBC.x, newNormalBC.y, newNormalBC.z, 0, 0
-					});
-				}
-				// A is solo on Front
-				else
-				{
-					std::pair<bool, unsigned> isBBack = isIn(backOldIndices, B);
-					std::pair<bool, unsigned> isCBack = isIn(backOldIndices, C);
-
-					Vector3 AtoB = bPosition;
-					AtoB 		-= aPosition;
-					Vector3 AtoC = cPosition;
-					AtoC 		-= aPosition;
-
-					Vector3 AtoBPoint = splitter.pointIntersection(bPosition, AtoB);
-					Vector3 AtoCPoint = splitter.pointIntersection(bPosition, AtoC);
-
-					Vector3 scaleAB = AtoBPoint - aPosition;
-					scaleAB /= AtoB;
-					Vector3 newNormalAB = normalA.linearInterpolation(normalB, scaleAB);
-
-					Vector3 scaleAC = AtoCPoint - aPosition;
-					scaleAC /= AtoC;
-					Vector3 newNormalAC = normalA.linearInterpolation(normalC, scaleAC);
-
-					// BACK
-					frontIndices.insert(frontIndices.end(), 
-					{
-						isAFront.second,
-						static_cast<unsigned>( frontVertexData.size() ),
-						static_cast<unsigned>( frontVertexData.size() + 1 )
-					});
-					frontVertexData.insert(frontVertexData.end(), 
-					{
-						AtoBPoint.x, AtoBPoint.y, AtoBPoint.z, newNormalAB.x, newNormalAB.y, newNormalAB.z, 0, 0,
-						AtoCPoint.x, AtoCPoint.y, AtoCPoint.z, newNormalAC.x, newNormalAC.y, newNormalAC.z, 0, 0
-					});
-
-					// FRONT
-					backIndices.insert(backIndices.end(), 
-					{
-						// Triangle 1
-						static_cast<unsigned>( backVertexData.size() ),
-						isBBack.second,
-						isCBack.second,
-
-						// Triangle 2
-						static_cast<unsigned>( backVertexData.size() + 1 ),
-						static_cast<unsigned>( backVertexData.size() ),
-						isCBack.second
-					});
-					backVertexData.insert(backVertexData.end(), 
-					{
-						AtoBPoint.x, AtoBPoint.y, AtoBPoint.z, newNormalAB.x, newNormalAB.y, newNormalAB.z, 0, 0,
-						AtoCPoint.x, AtoCPoint.y, AtoCPoint.z, newNormalAC.x, newNormalAC.y, newNormalAC.z, 0, 0
-					});
-				}
+				frontPolygon[frontCount++] = getVertex(corners[i]);
 			}
-			else if (isBFront.first)
+			else
 			{
-				std::pair<bool, unsigned> isABack = isIn(backOldIndices, A);
-				// A is solo on Back
-				if (isCFront.first)
-				{
-					Vector3 AtoB = bPosition;
-					AtoB 		-= aPosition;
-					Vector3 AtoC = cPosition;
-					AtoC 		-= aPosition;
-
-					Vector3 AtoBPoint = splitter.pointIntersection(bPosition, AtoB);
-					Vector3 AtoCPoint = splitter.pointIntersection(bPosition, AtoC);
-
-					Vector3 scaleAB = AtoBPoint - aPosition;
-					scaleAB /= AtoB;
-					Vector3 newNormalAB = normalA.linearInterpolation(normalB, scaleAB);
-
-					Vector3 scaleAC = AtoCPoint - aPosition;
-					scaleAC /= AtoC;
-					Vector3 newNormalAC = normalA.linearInterpolation(normalC, scaleAC);
-
-					// BACK
-					backIndices.insert(backIndices.end(), 
-					{
-						isABack.second,
-						static_cast<unsigned>( backVertexData.size() ),
-						static_cast<unsigned>( backVertexData.size() + 1 )
-					});
-					backVertexData.insert(backVertexData.end(), 
-					{
-						AtoBPoint.x, AtoBPoint.y, AtoBPoint.z, newNormalAB.x, newNormalAB.y, newNormalAB.z, 0, 0,
-						AtoCPoint.x, AtoCPoint.y, AtoCPoint.z, newNormalAC.x, newNormalAC.y, newNormalAC.z, 0, 0
-					});
-
-					// FRONT
-					frontIndices.insert(frontIndices.end(), 
-					{
-						// Triangle 1
-						static_cast<unsigned>( frontVertexData.size() ),
-						isBFront.second,
-						isCFront.second,
-
-						// Triangle 2
-						static_cast<unsigned>( frontVertexData.size() + 1 ),
-						static_cast<unsigned>( frontVertexData.size() ),
-						isCFront.second
-					});
-					frontVertexData.insert(frontVertexData.end(), 
-					{
-						AtoBPoint.x, AtoBPoint.y, AtoBPoint.z, newNormalAB.x, newNormalAB.y, newNormalAB.z, 0, 0,
-						AtoCPoint.x, AtoCPoint.y, AtoCPoint.z, newNormalAC.x, newNormalAC.y, newNormalAC.z, 0, 0
-					});
-				}
-				// B is solo on Front
-				else
-				{
-					std::pair<bool, unsigned> isCBack = isIn(backOldIndices, C);
-					Vector3 BtoA = aPosition;
-					BtoA 		-= bPosition;
-					Vector3 BtoC = cPosition;
-					BtoC 		-= bPosition;
-
-					Vector3 BtoAPoint = splitter.pointIntersection(bPosition, BtoA);
-					Vector3 BtoCPoint = splitter.pointIntersection(bPosition, BtoC);
-
-					Vector3 scaleBA = BtoAPoint - bPosition;
-					scaleBA /= BtoA;
-					Vector3 newNormalBA = normalB.linearInterpolation(normalA, scaleBA);
-
-					Vector3 scaleBC = BtoCPoint - bPosition;
-					scaleBC /= BtoC;
-					Vector3 newNormalBC = normalB.linearInterpolation(normalC, scaleBC);
-
-					// FRONT
-					frontIndices.insert(frontIndices.end(), 
-					{
-						static_cast<unsigned>( frontVertexData.size() ),
-						isBFront.second,
-						static_cast<unsigned>( frontVertexData.size() + 1 )
-					});
-					frontVertexData.insert(frontVertexData.end(), 
-					{
-						BtoAPoint.x, BtoAPoint.y, BtoAPoint.z, newNormalBA.x, newNormalBA.y, newNormalBA.z, 0, 0,
-						BtoCPoint.x, BtoCPoint.y, BtoCPoint.z, newNormalBC.x, newNormalBC.y, newNormalBC.z, 0, 0
-					});
-
-					// BACK
-					backIndices.insert(backIndices.end(), 
-					{
-						// Triangle 1
-						isABack.second,
-						static_cast<unsigned>( backVertexData.size() ),
-						isCBack.second,
-
-						// Triangle 2
-						static_cast<unsigned>( backVertexData.size() ),
-						static_cast<unsigned>( backVertexData.size() + 1 ),
-						isCBack.second
-					});
-					backVertexData.insert(backVertexData.end(), 
-					{
-						BtoAPoint.x, BtoAPoint.y, BtoAPoint.z, newNormalBA.x, newNormalBA.y, newNormalBA.z, 0, 0,
-						BtoCPoint.x, BtoCPoint.y, BtoCPoint.z, newNormalBC.x, newNormalBC.y, newNormalBC.z, 0, 0
-					});
-				}
+				backPolygon[backCount++] = getVertex(corners[i]);
 			}
-			// C is solo on Front
-			else
+
+			if (isFront[i] != isFront[j])
 			{
-				std::pair<bool, unsigned> isABack = isIn(backOldIndices, A);
-				std::pair<bool, unsigned> isBBack = isIn(backOldIndices, B);
-
-				Vector3 CtoA = aPosition;
-				CtoA 		-= cPosition;
-				Vector3 CtoB = bPosition;
-				CtoB 		-= cPosition;
-
-				Vector3 CtoAPoint = splitter.pointIntersection(cPosition, CtoA);
-				Vector3 CtoBPoint = splitter.pointIntersection(cPosition, CtoB);
-
-				Vector3 scaleCA = CtoAPoint - cPosition;
-				scaleCA /= CtoA;
-				Vector3 newNormalCA = normalC.linearInterpolation(normalA, scaleCA);
-
-				Vector3 scaleCB = CtoBPoint - cPosition;
-				scaleCB /= CtoB;
-				Vector3 newNormalCB = normalC.linearInterpolation(normalB, scaleCB);
-
-				// FRONT 
-				frontIndices.insert(frontIndices.end(), 
-				{
-					static_cast<unsigned>( frontVertexData.size() ),
-					static_cast<unsigned>( frontVertexData.size() + 1 ),
-					isCFront.second
-				});
-				frontVertexData.insert(frontVertexData.end(), 
-				{
-					CtoAPoint.x, CtoAPoint.y, CtoAPoint.z, newNormalCA.x, newNormalCA.y, newNormalCA.z, 0, 0,
-					CtoBPoint.x, CtoBPoint.y, CtoBPoint.z, newNormalCB.x, newNormalCB.y, newNormalCB.z, 0, 0
-				});
-
-				// BACK
-				backIndices.insert(backIndices.end(), 
-				{
-					// Triangle 1
-					isABack.second,
-					isBBack.second,
-					static_cast<unsigned>( backVertexData.size() ),
-
-					// Triangle 2
-					static_cast<unsigned>( backVertexData.size() ),
-					isBBack.second,
-					static_cast<unsigned>( backVertexData.size() + 1 )
-				});
-				backVertexData.insert(backVertexData.end(), 
-				{
-					CtoAPoint.x, CtoAPoint.y, CtoAPoint.z, newNormalCA.x, newNormalCA.y, newNormalCA.z, 0, 0,
-					CtoBPoint.x, CtoBPoint.y, CtoBPoint.z, newNormalCB.x, newNormalCB.y, newNormalCB.z, 0, 0
-				});
+				std::pair<unsigned, unsigned> cut = getCutVertex(corners[i], corners[j]);
+				frontPolygon[frontCount++] = cut.first;
+				backPolygon[backCount++] = cut.second;
 			}
 		}
-	}
-	Mesh* front = new Mesh(frontVertexData, frontIndices);
-	Mesh* back  = new Mesh(backVertexData , backIndices );
-	return std::make_pair(front, back);
-}
 
-// returns if it is in the vector 
-//	and the position since the position will be the new index
-//	since the vertices were put in order
-std::pair<bool, unsigned>
-isIn(std::vector<unsigned>& v, unsigned A)
-{
-	/*int left = 0;
-	int right = v.size() - 1;
-	int middle = 0;
-	while (left < right)
-	{
-		middle = (left + (right - left)) / 2;
-		if (v[middle] == A)
+		// Fan triangulation keeps the original winding
+		for (unsigned i = 1; i + 1 < frontCount; ++i)
 		{
-			std::cout << "GETS HERE" << std::endl;
-			return std::make_pair(true, middle);
+			sides[0].indices.insert(sides[0].indices.end(), { frontPolygon[0], frontPolygon[i], frontPolygon[i + 1] });
 		}
-		else if (v[middle] < A)
+		for (unsigned i = 1; i + 1 < backCount; ++i)
 		{
-			left = middle + 1;
-		}
-		else
-		{
-			right = middle - 1;
+			sides[1].indices.insert(sides[1].indices.end(), { backPolygon[0], backPolygon[i], backPolygon[i + 1] });
 		}
 	}
-	return std::make_pair(false, 0);*/
 
-	for (unsigned i = 0; i < v.size(); ++i)
+	Mesh* front = new Mesh(sides[0].vertexData, sides[0].indices, textureFilePath, sides[0].boneWeights, sides[0].boneIndices);
+	Mesh* back  = new Mesh(sides[1].vertexData, sides[1].indices, textureFilePath, sides[1].boneWeights, sides[1].boneIndices);
+	if (hasPositionStream())
 	{
-		if (v[i] == A)
-		{
-			return std::make_pair(true, i);
-		}
+		front->buildPositionStream();
+		back->buildPositionStream();
 	}
-	return std::make_pair(false, 0);
+	return std::make_pair(front, back);
 }
-
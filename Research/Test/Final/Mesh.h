@@ -17,11 +17,24 @@
 #include "Vector3.h"
 #include "ShaderProgram.h"
 #include "Frustum.h"
+#include "PositionStream.h"
+#include "InstanceBuffer.h"
+
+// Indices [first, first + count) of a mesh's index buffer
+struct IndexRange
+{
+	unsigned first;
+	unsigned count;
+};
 
 class Mesh
 {
 public:
 
+	// Position, normal and texture coordinate
+	static constexpr unsigned FLOATS_PER_VERTEX = 8;
+	static constexpr unsigned NUM_BONE_INDICES = 3;
+
 	std::string textureFilePath;
 
 	Mesh(const std::vector<float>& vertexData,  
@@ -30,6 +43,13 @@ public:
 		 const std::vector<float>& boneWeights 		= std::vector<float>(), 
 		 const std::vector<unsigned>& boneIndices 	= std::vector<unsigned>());
 
+	// Takes the geometry without copying it
+	Mesh(std::vector<float>&& vertexData,
+		 std::vector<unsigned>&& indices,
+		 const std::string&	texturePath 			= "",
+		 std::vector<float>&& boneWeights 			= std::vector<float>(),
+		 std::vector<unsigned>&& boneIndices 		= std::vector<unsigned>());
+
 	~Mesh ();
 
 	// Disable default copy ctor and copy assignment
@@ -47,9 +67,44 @@ public:
 	void
 	prepareVao ();
 
+	// Free the GL buffers but keep the CPU side geometry, for meshes whose
+	// 	geometry was merged into a MeshBatch
+	void
+	releaseVao ();
+
+	// Free the CPU side vertices and indices once prepareVao uploaded them.
+	// 	Counts and draws keep working, nothing else may read the geometry.
+	void
+	releaseGeometry ();
+
+	// Read positions, normals and texture coordinates from vertexBuffer,
+	// 	laid out like the vertex data, instead of the mesh's own buffer.
+	// 	0 restores the mesh's buffer.
+	// Precondition: prepareVao was called
+	void
+	setVertexBuffer (GLuint vertexBuffer);
+
 	void
 	draw();
 
+	// Draw count indices starting at firstIndex
+	void
+	draw(unsigned firstIndex, unsigned count);
+
+	// One glMultiDrawElements over several ranges of the index buffer
+	void
+	draw(const IndexRange* ranges, unsigned numRanges);
+
+	// Draw instanceCount copies reading per-instance matrices from instances
+	// 	starting at firstInstance
+	// Precondition: uInstanced is set and instances is uploaded
+	void
+	drawInstanced(const InstanceBuffer& instances, unsigned firstInstance, unsigned instanceCount);
+
+	void
+	drawInstanced(const InstanceBuffer& instances, unsigned firstInstance, unsigned instanceCount,
+		const IndexRange& range);
+
 	bool
 	hasTexture() const;
 
@@ -65,6 +120,28 @@ public:
 	unsigned
 	numVertices() const;
 
+	const std::vector<float>&
+	getVertexData() const;
+
+	const std::vector<unsigned>&
+	getIndices() const;
+
+	const std::vector<float>&
+	getBoneWeights() const;
+
+	const std::vector<unsigned>&
+	getBoneIndices() const;
+
+	// Optional SoA copy of the positions used by the bounding volume passes
+	void
+	buildPositionStream();
+
+	void
+	releasePositionStream();
+
+	bool
+	hasPositionStream() const;
+
 	Vector3
 	getMeshCenter() const;
 
@@ -74,8 +151,14 @@ public:
 	void
 	getRadius(SphereBV& sphere);
 
-	Matrix3
-	getCovarianceMatrix(const Vector3& mean, Matrix3& covarianceMatrix);
+	// Count, sum and second moments of every position in one pass
+	Moments
+	getMoments() const;
+
+	// Moments of vertices [first, first + count) so the work can be split
+	// 	across threads and merged
+	Moments
+	getMoments(unsigned first, unsigned count) const;
 
 	void
 	getBoxBV(std::vector<float>& lrbtnf);
@@ -83,11 +166,18 @@ public:
 	void
 	getBoxBV(std::vector<float>& lrbtnf, const Matrix3& rotation);
 
+	// Clip every triangle against splitter into new front and back meshes
 	std::pair<Mesh*, Mesh*>
-	split(Plane& splitter);
+	split(const Plane& splitter) const;
 
 private:
 
+	void
+	setVertexAttributes ();
+
+	static void
+	mergeBoxLimits(std::vector<float>& lrbtnf, const Vector3& min, const Vector3& max);
+
 	GLuint m_vao;
 	GLuint m_vbo;
 	GLuint m_ibo;
@@ -98,12 +188,10 @@ private:
 	std::vector<unsigned> m_indices;
 	std::vector<float> m_boneWeights;
 	std::vector<unsigned> m_boneIndices;
+	PositionStream m_positions;
+	// Outlive the arrays after releaseGeometry
+	unsigned m_numIndices;
+	unsigned m_numVertices;
 
 	bool isPrepared;
-	
-	static constexpr unsigned FLOATS_PER_VERTEX = 8;
-	static constexpr unsigned NUM_BONE_INDICES = 3;
 };
-
-std::pair<bool, unsigned>
-isIn(std::vector<unsigned>& v, unsigned A);
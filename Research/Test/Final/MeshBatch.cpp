@@ -0,0 +1,74 @@
+#include "MeshBatch.h"
+
+MeshBatch::MeshBatch(const std::string& texturePath)
+: m_texturePath(texturePath)
+, m_mesh(nullptr)
+, m_ranges()
+{ }
+
+MeshBatch::~MeshBatch()
+{
+	delete m_mesh;
+}
+
+unsigned
+MeshBatch::add(const Mesh& source)
+{
+	const unsigned first = m_mesh == nullptr ? 0 : m_mesh->numIndices();
+	if (m_mesh == nullptr)
+	{
+		m_mesh = new Mesh(source.getVertexData(), source.getIndices(), m_texturePath);
+	}
+	else
+	{
+		m_mesh->addGeometry(source.getVertexData(), source.getIndices());
+	}
+	m_ranges.push_back({ first, source.numIndices() });
+	return m_ranges.size() - 1;
+}
+
+void
+MeshBatch::prepare()
+{
+	if (m_mesh != nullptr)
+	{
+		m_mesh->prepareVao();
+	}
+}
+
+Mesh*
+MeshBatch::getMesh() const
+{
+	return m_mesh;
+}
+
+const IndexRange&
+MeshBatch::getRange(unsigned subMesh) const
+{
+	return m_ranges[subMesh];
+}
+
+unsigned
+MeshBatch::numSubMeshes() const
+{
+	return m_ranges.size();
+}
+
+const std::string&
+MeshBatch::getTexturePath() const
+{
+	return m_texturePath;
+}
+
+void
+MeshBatch::appendRange(std::vector<IndexRange>& ranges, const IndexRange& range)
+{
+	if (!ranges.empty() && ranges.back().first + ranges.back().count == range.first)
+	{
+		ranges.back().count += range.count;
+	}
+	else
+	{
+		ranges.push_back(range);
+	}
+}
@@ -0,0 +1,58 @@
+/*
+  FileName    : MeshBatch.h
+  Author      : Zachary Zuch
+  Description : Static meshes sharing a texture merged into one vertex and
+  				index buffer. Each source mesh stays addressable as an index
+  				range so visible parts can still be drawn on their own,
+  				several at a time with glMultiDrawElements.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+
+class MeshBatch
+{
+public:
+
+	explicit MeshBatch(const std::string& texturePath);
+
+	~MeshBatch();
+
+	// Disable default copy ctor and copy assignment
+	MeshBatch (const MeshBatch&) = delete;
+	MeshBatch& operator= (const MeshBatch&) = delete;
+
+	// Append source's geometry and return its submesh index
+	// Precondition: source is boneless and has this batch's texture
+	unsigned
+	add(const Mesh& source);
+
+	// Create the shared buffers once every submesh is added
+	void
+	prepare();
+
+	Mesh*
+	getMesh() const;
+
+	const IndexRange&
+	getRange(unsigned subMesh) const;
+
+	unsigned
+	numSubMeshes() const;
+
+	const std::string&
+	getTexturePath() const;
+
+	// Append range to ranges, extending the last one when they touch
+	static void
+	appendRange(std::vector<IndexRange>& ranges, const IndexRange& range);
+
+private:
+
+	std::string m_texturePath;
+	Mesh* m_mesh;
+	std::vector<IndexRange> m_ranges;
+};
@@ -1,12 +1,12 @@
 #include "MeshNode.h"
-#include <gsl/gsl_eigen.h>
 
 MeshNode::MeshNode( const std::vector<std::vector<float>>& 									vertexData,
 		 			const std::vector<std::vector<unsigned>>& 							indices,
 		 			const std::vector<std::string>& 									texturePaths,
 	 	 			const std::vector<std::pair<std::vector<unsigned>, std::vector<float>>>& 	boneData)
-: sum(0)
-, numVerts(0)
+: localMoments()
+, moments()
+, boxLimits()
 , numInds(0)
 {
 	if (boneData.size() == 0)
@@ -26,6 +26,8 @@ MeshNode::MeshNode( const std::vector<std::vector<float>>& 									vertexData,
 	for (unsigned i = 0; i < meshes.size(); ++i)
 	{
 		meshes[i]->prepareVao();
+		// Hierarchy setup runs several bounding volume passes per mesh
+		meshes[i]->buildPositionStream();
 	}
 }
 
@@ -41,236 +43,167 @@ MeshNode::~MeshNode()
 	}
 }
 
-/*void
-MeshNode::calculateCenter()
+Matrix3 
+MeshNode::calculateAxisMatrix(Matrix3& covarianceMatrix)
 {
-	for (unsigned i = 0; i < meshes.size(); ++i)
-	{
-		sum += meshes[i]->getMassSum();
-		numVerts += meshes[i]->numVertices();
-		numInds += meshes[i]->numIndices();
-	}
-	localSphere.center = sum / numVerts;
-
-	for (unsigned i = 0; i < children.size(); ++i)
-	{
-		children[i]->calculateCenter();
-		numVerts += children[i]->numVerts;
-		sum += children[i]->sum;
-	}
-	sphere.center = sum / numVerts;
-}*/
+	// The three eigenvectors are the axises for the oriented bounding box
+	Vector3 eigenValues;
+	Matrix3 axis;
+	covarianceMatrix.symmetricEigen(eigenValues, axis);
+	return axis;
+}
 
-// Pre-Condition Calculate Center 
 void
-MeshNode::calculateSphereHierarchy()
+MeshNode::calculateBoundingVolumes()
 {
-	for (unsigned i = 0; i < meshes.size(); ++i)
-	{
-		sum += meshes[i]->getMassSum();
-		numVerts += meshes[i]->numVertices();
-		numInds += meshes[i]->numIndices();
-	}
-	localSphere.center = sum / numVerts;
+	fitBoundingVolumes();
+	releasePositionStreams();
+}
 
+void
+MeshNode::fitBoundingVolumes()
+{
 	for (unsigned i = 0; i < children.size(); ++i)
 	{
-		children[i]->calculateSphereHierarchy();
-		numVerts += children[i]->numVerts;
-		sum += children[i]->sum;
+		children[i]->fitBoundingVolumes();
 	}
-	sphere.center = sum / numVerts;
-	
+
+	/******************************************************************************/
+	// Aggregates: one moment pass and one limit pass over this node's meshes
+
+	localMoments = Moments();
+	std::vector<float> localLimits;
+	numInds = 0;
 	for (unsigned i = 0; i < meshes.size(); ++i)
 	{
-		meshes[i]->getRadius(localSphere);
+		if (meshes[i]->isEmpty()) continue;
+		localMoments.merge(meshes[i]->getMoments());
+		meshes[i]->getBoxBV(localLimits);
+		numInds += meshes[i]->numIndices();
 	}
-	sphere.radius = localSphere.radius;
 
+	moments = localMoments;
+	boxLimits = localLimits;
 	for (unsigned i = 0; i < children.size(); ++i)
 	{
-		children[i]->getFarthestLength(sphere);
+		if (children[i]->moments.isEmpty()) continue;
+		moments.merge(children[i]->moments);
+		if (boxLimits.size() == 0)
+		{
+			boxLimits = children[i]->boxLimits;
+		}
+		else
+		{
+			compareBoxLimits(boxLimits, children[i]->boxLimits);
+		}
 	}
-}
 
-std::vector<float>
-MeshNode::calculateBoxHierarchy()
-{
-	std::vector<float> lrbtnf;
-	for (unsigned i = 0; i < meshes.size(); ++i)
+	// Nodes without any geometry collapse to a point at the hierarchy center
+	Vector3 center = moments.mean();
+	if (boxLimits.size() == 0)
 	{
-		meshes[i]->getBoxBV(lrbtnf);
+		boxLimits = { center.x, center.x, center.y, center.y, center.z, center.z };
 	}
-	localBox.init(lrbtnf);
-
-	for (unsigned i = 0; i < children.size(); ++i)
+	if (localLimits.size() == 0)
 	{
-		compareBoxLimits(lrbtnf, children[i]->calculateBoxHierarchy());
+		localLimits = { center.x, center.x, center.y, center.y, center.z, center.z };
 	}
-	box.init(lrbtnf);
-	return lrbtnf;
-}
 
-Matrix3 
-MeshNode::calculateAxisMatrix(Matrix3& covarianceMatrix)
-{
-	// setup for gsl library
-	// gsl is a c function library so pointers 
-	//	must be allocated and destroyed will explicit calls
-	constexpr unsigned MATRIX_ROW_MAX = 3;
-	gsl_eigen_symmv_workspace* w = gsl_eigen_symmv_alloc(MATRIX_ROW_MAX);
-	gsl_matrix* cov = gsl_matrix_calloc(MATRIX_ROW_MAX, MATRIX_ROW_MAX);
-	for (unsigned i = 0; i < MATRIX_ROW_MAX; ++i)
-	{
-		for (unsigned j = 0; j < MATRIX_ROW_MAX; ++j)
-		{
-			gsl_matrix_set(cov, i, j, covarianceMatrix.getValue(i,j));
-		}
-	}
-	gsl_vector* eval = gsl_vector_calloc(MATRIX_ROW_MAX);
-	gsl_matrix* evec = gsl_matrix_calloc(MATRIX_ROW_MAX, MATRIX_ROW_MAX);
+	localBox.init(localLimits);
+	box.init(boxLimits);
 
-	// gsl eigen call for real symmetric matrix which a covariance of primitve positions is
-	gsl_eigen_symmv(cov, eval, evec, w);
-	gsl_matrix_free(cov);
-	gsl_eigen_symmv_free(w);
-	gsl_vector_free(eval);
+	/******************************************************************************/
+	// Spheres: centered on the moments, out to the farthest vertex
 
-	// The three eigenvectors are the axises for the oriented bounding box
-	std::vector<Vector3> eigenVectors;
-	eigenVectors.reserve(3);
+	localSphere.center = localMoments.isEmpty() ? center : localMoments.mean();
+	localSphere.radius = 0;
+	for (unsigned i = 0; i < meshes.size(); ++i)
+	{
+		if (meshes[i]->isEmpty()) continue;
+		meshes[i]->getRadius(localSphere);
+	}
 
-	eigenVectors.push_back(
-	Vector3(
-		gsl_matrix_get(evec, 0, 0),
-		gsl_matrix_get(evec, 1, 0),
-		gsl_matrix_get(evec, 2, 0)
-	));
+	sphere.center = center;
+	sphere.radius = 0;
+	growSphere(sphere);
 
-	eigenVectors.push_back(
-	Vector3(
-		gsl_matrix_get(evec, 0, 1),
-		gsl_matrix_get(evec, 1, 1),
-		gsl_matrix_get(evec, 2, 1)
-	));
+	/******************************************************************************/
+	// Oriented boxes: axes come from the moments, only the extents read vertices
 
-	eigenVectors.push_back(
-	Vector3(
-		gsl_matrix_get(evec, 0, 2),
-		gsl_matrix_get(evec, 1, 2),
-		gsl_matrix_get(evec, 2, 2)
-	));
-	gsl_matrix_free(evec);
+	Matrix3 covarianceMatrix = localMoments.covariance();
+	Matrix3 rotationMatrix = calculateAxisMatrix(covarianceMatrix);
+	Matrix3 inverseRotation = rotationMatrix;
+	inverseRotation.invertRotation();
 
-	for (Vector3& eigenVector : eigenVectors)
+	std::vector<float> lrbtnf;
+	for (unsigned i = 0; i < meshes.size(); ++i)
 	{
-		eigenVector.normalize();
+		if (meshes[i]->isEmpty()) continue;
+		meshes[i]->getBoxBV(lrbtnf, inverseRotation);
 	}
-	Matrix3 axis(eigenVectors[0], eigenVectors[1], eigenVectors[2]);
-	return axis;
-}
-
-void
-MeshNode::getCovarianceHierarchy(Vector3& center, Matrix3& covariance)
-{
-	for (unsigned i = 0; i < meshes.size(); ++i)
+	if (lrbtnf.size() == 0)
 	{
-		meshes[i]->getCovarianceMatrix(center, covariance);
+		Vector3 point = inverseRotation * localSphere.center;
+		lrbtnf = { point.x, point.x, point.y, point.y, point.z, point.z };
 	}
-	for (unsigned i = 0; i < children.size(); ++i)
+	localOrientedBox.init(lrbtnf, rotationMatrix);
+
+	covarianceMatrix = moments.covariance();
+	rotationMatrix = calculateAxisMatrix(covarianceMatrix);
+	inverseRotation = rotationMatrix;
+	inverseRotation.invertRotation();
+
+	// Fitting around the children's boxes would loosen every level, so the
+	// 	extents come from the vertices on the merged axes
+	lrbtnf.clear();
+	growRotatedLimits(lrbtnf, inverseRotation);
+	if (lrbtnf.size() == 0)
 	{
-		children[i]->getCovarianceHierarchy(center, covariance);
+		Vector3 point = inverseRotation * center;
+		lrbtnf = { point.x, point.x, point.y, point.y, point.z, point.z };
 	}
+	orientedBox.init(lrbtnf, rotationMatrix);
 }
 
 void
-MeshNode::getCenterOfHierarchy(unsigned& n, Vector3& massCenter)
+MeshNode::growSphere(SphereBV& sphere)
 {
 	for (unsigned i = 0; i < meshes.size(); ++i)
 	{
-		massCenter += meshes[i]->getMassSum();
-		n += meshes[i]->numVertices();
+		if (meshes[i]->isEmpty()) continue;
+		meshes[i]->getRadius(sphere);
 	}
 	for (unsigned i = 0; i < children.size(); ++i)
 	{
-		children[i]->getCenterOfHierarchy(n, massCenter);
+		children[i]->growSphere(sphere);
 	}
 }
 
 void
-MeshNode::getOrientedHierarchy(std::vector<float>& lrbtnf, Matrix3& rotation)
+MeshNode::growRotatedLimits(std::vector<float>& lrbtnf, const Matrix3& inverseRotation)
 {
 	for (unsigned i = 0; i < meshes.size(); ++i)
 	{
-		meshes[i]->getBoxBV(lrbtnf, rotation);
+		if (meshes[i]->isEmpty()) continue;
+		meshes[i]->getBoxBV(lrbtnf, inverseRotation);
 	}
 	for (unsigned i = 0; i < children.size(); ++i)
 	{
-		children[i]->getOrientedHierarchy(lrbtnf, rotation);
+		children[i]->growRotatedLimits(lrbtnf, inverseRotation);
 	}
 }
 
 void
-MeshNode::calculateLocalOrientedBoxHierarchy()
+MeshNode::releasePositionStreams()
 {
-	Vector3 vectorSum(0);
-	unsigned numV = 0;
-	for (unsigned i = 0; i < meshes.size(); ++i)
-	{
-		vectorSum += meshes[i]->getMassSum();
-		numV += meshes[i]->numVertices();
-	}
-	Vector3 localCenter = sum / numV;
-
-	Matrix3 covarianceMatrix;
-	covarianceMatrix.setToZero();
-	for (unsigned i = 0; i < meshes.size(); ++i)
-	{
-		meshes[i]->getCovarianceMatrix(localCenter, covarianceMatrix);
-	}
-
-	/******************************************************************************/
-
-	Matrix3 rotationMatrix = calculateAxisMatrix(covarianceMatrix);
-	
-	/******************************************************************************/
-
-	rotationMatrix.invertRotation();
-	std::vector<float> lrbtnf;
+	// Ancestors read the streams too, so they are only done with at the end
 	for (unsigned i = 0; i < meshes.size(); ++i)
 	{
-		meshes[i]->getBoxBV(lrbtnf, rotationMatrix);
-	}
-	rotationMatrix.invertRotation();
-	localOrientedBox.init(lrbtnf, rotationMatrix);
-
-	/******************************************************************************/
-
-	for (unsigned i = 0; i < children.size(); ++i)
-	{
-		children[i]->getCenterOfHierarchy(numV, vectorSum);
-	}
-	Vector3 center = sum / numV;
-
-	covarianceMatrix.setToZero();
-	for (unsigned i = 0; i < children.size(); ++i)
-	{
-		getCovarianceHierarchy(center, covarianceMatrix);
+		meshes[i]->releasePositionStream();
 	}
-
-	rotationMatrix = calculateAxisMatrix(covarianceMatrix);
-
-	rotationMatrix.invertRotation();
-	lrbtnf.clear();
-	getOrientedHierarchy(lrbtnf, rotationMatrix);
-	rotationMatrix.invertRotation();
-	orientedBox.init(lrbtnf, rotationMatrix);
-
-	/******************************************************************************/
-
 	for (unsigned i = 0; i < children.size(); ++i)
 	{
-		children[i]->calculateLocalOrientedBoxHierarchy();
+		children[i]->releasePositionStreams();
 	}
 }
 
@@ -297,64 +230,14 @@ MeshNode::compareBoxLimits(std::vector<float>& box, const std::vector<float>& ch
 }
 
 void
-MeshNode::getFarthestLength(SphereBV& sphere)
+MeshNode::flatten(std::vector<MeshNode*>& nodes, std::vector<unsigned>& subtreeEnds)
 {
-	for (unsigned i = 0; i < meshes.size(); ++i)
-	{
-		meshes[i]->getRadius(sphere);
-	}
+	unsigned index = nodes.size();
+	nodes.push_back(this);
+	subtreeEnds.push_back(0);
 	for (unsigned i = 0; i < children.size(); ++i)
 	{
-		children[i]->getFarthestLength(sphere);
-	}
-}
-
-unsigned
-MeshNode::draw(ShaderProgram* shaderProgram, Transform& modelView, Matrix3& normal, SphereDebug& sphereD, Frustum& planes, std::unordered_map<std::string, Texture*>& textures)
-{
-	unsigned numTriangles = 0;
-	// if (planes.inFrustum(sphere))
-	// {
-	if (planes.inFrustum(orientedBox))
-	{
-		// if (planes.inFrustum(orientedBox))
-		// {
-		// if (children.size() == 0 || planes.inFrustum(localSphere))
-		// {
-	// if (planes.inFrustum(box))
-	// {
-	// 	if (children.size() == 0 || planes.inFrustum(localBox))
-	// 	{
-			shaderProgram->setUniform ("uModelView", modelView.getTransform());
-			shaderProgram->setUniform ("uNormalMatrix", normal);
-			for (unsigned i = 0; i < meshes.size(); ++i)
-			{
-				if (meshes[i]->hasTexture())
-				{
-					shaderProgram->setUniform ("uHasTexture", meshes[i]->hasTexture());
-					// std::cout << meshes[i]->textureFilePath << std::endl;
-					textures[meshes[i]->textureFilePath]->bind();
-					meshes[i]->draw();
-					textures[meshes[i]->textureFilePath]->unbind();
-				}
-				else
-				{
-					meshes[i]->draw();
-				}
-			}
-			sphereD.init(orientedBox);
-			// sphereD.init(localBox);
-			// sphereD.init(box);
-			// sphereD.init(localSphere);
-			// sphereD.init(sphere);
-			sphereD.draw(shaderProgram, modelView);
-
-			numTriangles += numInds / NUM_INDICES_PER_TRIANGLE;
-		// }
-		for (unsigned i = 0; i < children.size(); ++i)
-		{
-			numTriangles += children[i]->draw(shaderProgram, modelView, normal, sphereD, planes, textures);
-		}
+		children[i]->flatten(nodes, subtreeEnds);
 	}
-	return numTriangles;
+	subtreeEnds[index] = nodes.size();
 }
@@ -22,37 +22,29 @@ public:
 
 	~MeshNode();
 
+	// Single post-order pass over the hierarchy. Moments and box limits are
+	// 	merged up from the children, only the hierarchy sphere radius and
+	// 	oriented box extents read the vertices below each node so they fit
+	// 	as tightly as the local ones. The meshes' position streams are
+	// 	released afterwards, a second call uses the scalar passes.
 	void
-	getCovarianceHierarchy(Vector3& center, Matrix3& covariance);
-
-	void
-	getCenterOfHierarchy(unsigned& n, Vector3& massCenter);
-
-	void
-	getOrientedHierarchy(std::vector<float>& lrbtnf, Matrix3& rotation);
-
-	void
-	calculateSphereHierarchy();
-
-	std::vector<float>
-	calculateBoxHierarchy();
-
-	void
-	calculateLocalOrientedBoxHierarchy();
+	calculateBoundingVolumes();
 
 	void
 	compareBoxLimits(std::vector<float>& box, const std::vector<float>& childBox);
 
+	// Pre-order list of this hierarchy. subtreeEnds[i] is one past the last
+	// 	descendant of nodes[i] so a culled node's subtree can be skipped.
 	void
-	getFarthestLength(SphereBV& sphere);
-
-	unsigned
-	draw(ShaderProgram* shaderProgram, Transform& modelView, Matrix3& normal, SphereDebug& sphereD, Frustum& planes, std::unordered_map<std::string, Texture*>& textures);
+	flatten(std::vector<MeshNode*>& nodes, std::vector<unsigned>& subtreeEnds);
 
 	std::vector<MeshNode*> children;
 	std::vector<Mesh*> meshes;
-	Vector3 sum;
-	float numVerts;
+	// Moments of this node's meshes and of the whole hierarchy below it
+	Moments localMoments;
+	Moments moments;
+	// Axis aligned limits (lrbtnf) of the whole hierarchy
+	std::vector<float> boxLimits;
 	unsigned numInds;
 	SphereBV sphere;
 	SphereBV localSphere;
@@ -67,4 +59,18 @@ private:
 
 	Matrix3 
 	calculateAxisMatrix(Matrix3& covarianceMatrix);
+
+	void
+	fitBoundingVolumes();
+
+	// Grow sphere's radius to reach every vertex of this hierarchy
+	void
+	growSphere(SphereBV& sphere);
+
+	// Grow lrbtnf by every vertex of this hierarchy in the rotated frame
+	void
+	growRotatedLimits(std::vector<float>& lrbtnf, const Matrix3& inverseRotation);
+
+	void
+	releasePositionStreams();
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <utility>
 #include <iostream>
+#include <limits>
 
 #include "Model.h"
 #include "AiScene.h"
@@ -14,9 +15,35 @@ LEAK SUMMARY:
 ==1801==         suppressed: 0 bytes in 0 blocks
 */
 
+bool Model::m_isBuildingSpatialIndex = false;
+
 Model::Model(const std::string& filename, const Transform& beginOrientation)
-  : m_textures()
+  : root(nullptr)
+  , m_nodes()
+  , m_subtreeEnds()
+  , m_batches()
+  , m_nodeSubMeshes()
+  , m_nodeMeshes()
+  , m_batchRanges()
+  , m_batchDepths()
+  , m_lastRejectingPlane()
+  , m_instancePlanes()
+  , m_visibleItems()
+  , m_renderQueue()
+  , m_isInstanced(false)
+  , m_instances()
+  , m_nodeInstanceStarts()
+  , m_bonePalette(nullptr)
+  , m_materialData(nullptr)
+  , m_skeleton(nullptr)
+  , m_skinners()
+  , m_palette()
+  , m_paletteVersion(~0u)
+  , m_textures()
   , m_transforms()
+  , bspRoot(nullptr)
+  , m_bvhTree(nullptr)
+  , m_bone(nullptr)
   , name(filename)
   , material()
 {
@@ -28,7 +55,21 @@ Model::Model(const std::string& filename, const Transform& beginOrientation)
 
 Model::~Model()
 {
+	// Skinners point their meshes back at their own buffers
+	for (CpuSkinner* skinner : m_skinners)
+	{
+		delete skinner;
+	}
 	delete root;
+	delete bspRoot;
+	delete m_bvhTree;
+	delete m_bonePalette;
+	delete m_materialData;
+	delete m_skeleton;
+	for (MeshBatch* batch : m_batches)
+	{
+		delete batch;
+	}
   	for (std::pair<std::string, Texture*> pTexture : m_textures)
   	{
   		delete pTexture.second;
@@ -71,16 +112,35 @@ Model::importFromFile(const std::string& filename, const Transform& beginOrienta
 	
 
 	root = scene.getMeshHierarchy();
-	// bspRoot = new BSPTree(new Mesh(scene.getAllVertexData(), scene.getAllFaceIndices()));
-	
-	// root->calculateCenter();
-	root->calculateSphereHierarchy();
-	root->calculateBoxHierarchy();
-	root->calculateLocalOrientedBoxHierarchy();
+	if (m_isBuildingSpatialIndex)
+	{
+		bspRoot = BSPTree::loadOrBuild(filename, filename + ".bsp", [&scene]()
+		{
+			return new Mesh(scene.getAllVertexData(), scene.getAllFaceIndices());
+		});
+		m_bvhTree = new BVHTree(new Mesh(scene.getAllVertexData(), scene.getAllFaceIndices()));
+	}
+
+	root->calculateBoundingVolumes();
+	root->flatten(m_nodes, m_subtreeEnds);
+	batchStaticMeshes();
 
 	m_bone = scene.getBones();
 	if (m_bone != nullptr)
 	{
+		m_skeleton = new Skeleton(m_bone);
+		m_skeleton->compress();
+		m_bone->releaseKeys();
+		// Sized once, animation tasks fill the skeleton's palette and the
+		// 	draw copies it here after the fence
+		m_palette.resize(m_skeleton->size());
+		for (const std::vector<Mesh*>& meshes : m_nodeMeshes)
+		{
+			for (Mesh* mesh : meshes)
+			{
+				m_skinners.push_back(new CpuSkinner(mesh));
+			}
+		}
 		m_transforms.push_back(Transform());
 	}
 	else
@@ -100,51 +160,407 @@ Model::draw(ShaderProgram* shaderProgram, const Camera& camera, SphereDebug& sph
 
 unsigned
 Model::draw(ShaderProgram* shaderProgram, const Camera& camera, SphereDebug& sphere, bool isShaderHandled)
+{
+	CullContext cullContext;
+	cullContext.update(camera);
+	return draw(shaderProgram, camera, cullContext, sphere);
+}
+
+unsigned
+Model::draw(ShaderProgram* shaderProgram, const Camera& camera, const CullContext& cullContext, SphereDebug& sphere)
+{
+	prepareCull(cullContext);
+	m_visibleItems.clear();
+	std::vector<std::pair<unsigned, unsigned>> planeStack;
+	for (unsigned t = 0; t < m_transforms.size(); ++t)
+	{
+		cullInstance(t, planeStack, m_visibleItems);
+	}
+	return drawVisible(shaderProgram, camera, m_visibleItems, sphere, m_renderQueue);
+}
+
+void
+Model::prepareCull(const CullContext& cullContext)
+{
+	cullContext.transformPlanes(m_transforms, m_instancePlanes);
+	// Transforms are only ever appended so existing entries keep their place
+	m_lastRejectingPlane.resize(m_transforms.size() * m_nodes.size(), 0);
+}
+
+void
+Model::addInstanceBounds(BoundsBatch& bounds) const
+{
+	for (const Transform& transform : m_transforms)
+	{
+		if (m_nodes.empty())
+		{
+			bounds.add(transform.getPosition(), Vector3(0.0f));
+			continue;
+		}
+		// The batch reaches along unnormalized axes, so scale rides on them
+		const BoxBV& box = m_nodes[0]->orientedBox;
+		const Matrix3& orientation = transform.getOrientation(true);
+		bounds.add(orientation * box.center + transform.getPosition(), box.extent, orientation * box.axes);
+	}
+}
+
+void
+Model::cullInstance(unsigned transformIndex, std::vector<std::pair<unsigned, unsigned>>& planeStack,
+	std::vector<VisibleItem>& items)
+{
+	const unsigned numNodes = m_nodes.size();
+	if (numNodes == 0)
+	{
+		return;
+	}
+	const Frustum& planes = m_instancePlanes.frusta[transformIndex];
+	unsigned char* lastRejected = &m_lastRejectingPlane[transformIndex * numNodes];
+	planeStack.clear();
+	unsigned i = 0;
+	while (i < numNodes)
+	{
+		while (!planeStack.empty() && planeStack.back().first <= i)
+		{
+			planeStack.pop_back();
+		}
+		unsigned activePlanes = planeStack.empty() ? Frustum::ALL_PLANES : planeStack.back().second;
+
+		// A culled node hides its whole subtree
+		if (planes.classify(m_nodes[i]->orientedBox, activePlanes, lastRejected[i]) == Frustum::Containment::OUTSIDE)
+		{
+			i = m_subtreeEnds[i];
+			continue;
+		}
+		items.push_back({ this, transformIndex, i });
+		if (m_subtreeEnds[i] > i + 1)
+		{
+			planeStack.emplace_back(m_subtreeEnds[i], activePlanes);
+		}
+		++i;
+	}
+}
+
+unsigned
+Model::drawVisible(ShaderProgram* shaderProgram, const Camera& camera, const std::vector<VisibleItem>& items,
+	SphereDebug& sphere, RenderQueue& queue)
 {
 	unsigned numTriangles = 0;
+	const Transform& view = camera.getViewMatrix(true);
+	queue.clear();
+	unsigned begin = 0;
+	while (begin < items.size())
+	{
+		Model* model = items[begin].model;
+		unsigned end = begin + 1;
+		while (end < items.size() && items[end].model == model)
+		{
+			++end;
+		}
 
-	if (m_bone != nullptr)
+		model->updatePalette();
+		if (model->m_isInstanced)
+		{
+			model->setModelUniforms(shaderProgram);
+			numTriangles += model->drawInstanced(shaderProgram, view, items, begin, end);
+		}
+		else
+		{
+			model->enqueue(queue, shaderProgram, view, items, begin, end);
+		}
+		begin = end;
+	}
+	queue.sort();
+	numTriangles += queue.submit();
+
+	// Bounding volumes last, they set their own uniforms
+	for (const VisibleItem& item : items)
 	{
-		m_bone->setUniforms(shaderProgram);
-		shaderProgram->setUniform ("hasBones", true);
+		if (!item.model->m_isInstanced)
+		{
+			Transform modelView = view;
+			modelView.combine(item.model->m_transforms[item.transformIndex]);
+			sphere.init(item.model->m_nodes[item.node]->orientedBox);
+			sphere.draw(shaderProgram, modelView);
+		}
 	}
-	else
+	return numTriangles;
+}
+
+void
+Model::setInstanced(bool isInstanced)
+{
+	m_isInstanced = isInstanced;
+}
+
+bool
+Model::isInstanced() const
+{
+	return m_isInstanced;
+}
+
+void
+Model::setBuildSpatialIndex(bool isBuilding)
+{
+	m_isBuildingSpatialIndex = isBuilding;
+}
+
+void
+Model::printBuildQuality(const Camera& camera, std::ostream& out)
+{
+	if (bspRoot == nullptr || m_bvhTree == nullptr)
 	{
-		shaderProgram->setUniform ("hasBones", false);
+		return;
 	}
-	material.setUniforms(shaderProgram);
-	for (const Transform& world : m_transforms)
+	// Trees are in model space, Frustum takes the transposed matrix
+	Matrix4 viewProjection = camera.getProjectionMatrix();
+	viewProjection *= camera.getViewMatrix(true).getTransform();
+	viewProjection *= m_transforms[0].getTransform();
+	viewProjection.transpose();
+	out << name << std::endl;
+	::printBuildQuality(*m_bvhTree, *bspRoot, { viewProjection }, out);
+}
+
+void
+Model::batchStaticMeshes()
+{
+	std::unordered_map<std::string, unsigned> batchIndices;
+	m_nodeSubMeshes.assign(m_nodes.size(), std::vector<std::pair<unsigned, unsigned>>());
+	m_nodeMeshes.assign(m_nodes.size(), std::vector<Mesh*>());
+	for (unsigned n = 0; n < m_nodes.size(); ++n)
 	{
-		Transform modelView = camera.getViewMatrix();
-		modelView.combine(world);
+		for (Mesh* mesh : m_nodes[n]->meshes)
+		{
+			if (mesh->isEmpty())
+			{
+				continue;
+			}
+			if (!mesh->isBoneless())
+			{
+				m_nodeMeshes[n].push_back(mesh);
+				continue;
+			}
 
-		Matrix4 MVP = camera.getProjectionMatrix();
-		MVP *= modelView.getTransform();
-		// Transpose to match proper elements since algorithm uses the transpose of my matrix
-		MVP.transpose();
+			auto found = batchIndices.find(mesh->textureFilePath);
+			if (found == batchIndices.end())
+			{
+				found = batchIndices.insert({ mesh->textureFilePath, m_batches.size() }).first;
+				m_batches.push_back(new MeshBatch(mesh->textureFilePath));
+			}
+			const unsigned subMesh = m_batches[found->second]->add(*mesh);
+			m_nodeSubMeshes[n].emplace_back(found->second, subMesh);
+			// The node keeps its CPU copy for bounding volumes
+			mesh->releaseVao();
+		}
+	}
+	// Batches are only drawn from their GL buffers, by whole submesh ranges
+	for (MeshBatch* batch : m_batches)
+	{
+		batch->prepare();
+		batch->getMesh()->releaseGeometry();
+	}
+	m_batchRanges.resize(m_batches.size());
+	m_batchDepths.assign(m_batches.size(), std::numeric_limits<float>::max());
+}
 
-		Frustum planes( MVP );
+void
+Model::enqueue(RenderQueue& queue, ShaderProgram* shaderProgram, const Transform& view,
+	const std::vector<VisibleItem>& items, unsigned begin, unsigned end)
+{
+	unsigned transformIndex = 0;
+	unsigned instance = 0;
+	Transform modelView;
+	for (unsigned i = begin; i < end; ++i)
+	{
+		// Items of one instance are contiguous
+		if (i == begin || items[i].transformIndex != transformIndex)
+		{
+			if (i != begin)
+			{
+				flushBatches(queue, shaderProgram, instance);
+			}
+			transformIndex = items[i].transformIndex;
+			modelView = view;
+			modelView.combine(m_transforms[transformIndex]);
+			instance = queue.addInstance(modelView);
+		}
 
-		// if (planes.inFrustum(sphere))
-		// if (planes.inFrustum(root->sphere))
-		// {
-		material.setUniforms(shaderProgram);
-		Matrix3 normalMatrix = modelView.getOrientation();
-		normalMatrix.invert();
-		normalMatrix.transpose();
+		const unsigned n = items[i].node;
+		const Vector3 eyeCenter = modelView.getOrientation() * m_nodes[n]->orientedBox.center + modelView.getPosition();
+		for (Mesh* mesh : m_nodeMeshes[n])
+		{
+			Texture* texture = mesh->hasTexture() ? m_textures[mesh->textureFilePath] : nullptr;
+			queue.add(shaderProgram, texture, this, mesh, instance, -eyeCenter.z);
+		}
+		// Items are in pre-order, like the submeshes, so neighbouring
+		// 	visible nodes usually extend the same range
+		for (const std::pair<unsigned, unsigned>& subMesh : m_nodeSubMeshes[n])
+		{
+			MeshBatch::appendRange(m_batchRanges[subMesh.first], m_batches[subMesh.first]->getRange(subMesh.second));
+			if (-eyeCenter.z < m_batchDepths[subMesh.first])
+			{
+				m_batchDepths[subMesh.first] = -eyeCenter.z;
+			}
+		}
+	}
+	if (begin < end)
+	{
+		flushBatches(queue, shaderProgram, instance);
+	}
+}
 
-		shaderProgram->setUniform ("uModelView", modelView.getTransform());
-		shaderProgram->setUniform ("uNormalMatrix", normalMatrix);
-		shaderProgram->setUniform ("uHasTexture", false);
-		
-		numTriangles += root->draw(shaderProgram, modelView, normalMatrix, sphere, planes, m_textures);
+void
+Model::flushBatches(RenderQueue& queue, ShaderProgram* shaderProgram, unsigned instance)
+{
+	for (unsigned b = 0; b < m_batches.size(); ++b)
+	{
+		if (m_batchRanges[b].empty())
+		{
+			continue;
+		}
+		Mesh* mesh = m_batches[b]->getMesh();
+		Texture* texture = mesh->hasTexture() ? m_textures[mesh->textureFilePath] : nullptr;
+		queue.add(shaderProgram, texture, this, mesh, instance, m_batchDepths[b], m_batchRanges[b]);
+		m_batchRanges[b].clear();
+		m_batchDepths[b] = std::numeric_limits<float>::max();
+	}
+}
 
-		//bspRoot->draw(shaderProgram, camera, modelView, sphere);
-		// }
+void
+Model::updatePalette()
+{
+	// Frozen and unchanged poses are not copied or skinned again
+	if (m_skeleton != nullptr && m_skeleton->getPaletteVersion() != m_paletteVersion)
+	{
+		m_paletteVersion = m_skeleton->getPaletteVersion();
+		m_palette = m_skeleton->getPalette();
+		for (CpuSkinner* skinner : m_skinners)
+		{
+			skinner->skin(m_palette);
+			skinner->upload();
+		}
 	}
+}
+
+Skeleton*
+Model::getSkeleton()
+{
+	return m_skeleton;
+}
+
+unsigned
+Model::drawInstanced(ShaderProgram* shaderProgram, const Transform& view, const std::vector<VisibleItem>& items,
+	unsigned begin, unsigned end)
+{
+	// Bucket the items by node, in instance order, so each node's instances
+	// 	are one contiguous range of the instance buffer
+	m_nodeInstanceStarts.assign(m_nodes.size() + 1, 0);
+	for (unsigned i = begin; i < end; ++i)
+	{
+		++m_nodeInstanceStarts[items[i].node + 1];
+	}
+	for (unsigned n = 0; n < m_nodes.size(); ++n)
+	{
+		m_nodeInstanceStarts[n + 1] += m_nodeInstanceStarts[n];
+	}
+
+	m_instances.resize(end - begin);
+	std::vector<unsigned> next(m_nodeInstanceStarts.begin(), m_nodeInstanceStarts.end() - 1);
+	unsigned transformIndex = items[begin].transformIndex;
+	Transform modelView;
+	Matrix3 normalMatrix;
+	bool isFirst = true;
+	for (unsigned i = begin; i < end; ++i)
+	{
+		if (isFirst || items[i].transformIndex != transformIndex)
+		{
+			isFirst = false;
+			transformIndex = items[i].transformIndex;
+			modelView = view;
+			modelView.combine(m_transforms[transformIndex]);
+			normalMatrix = modelView.getOrientation();
+			normalMatrix.invert();
+			normalMatrix.transpose();
+		}
+		m_instances.set(next[items[i].node]++, modelView, normalMatrix);
+	}
+	m_instances.upload();
+
+	unsigned numTriangles = 0;
+	const ShaderProgram::Uniform<bool> hasTexture = shaderProgram->getUniform<bool>("uHasTexture");
+	shaderProgram->setUniform ("uInstanced", true);
+	for (unsigned n = 0; n < m_nodes.size(); ++n)
+	{
+		const unsigned firstInstance = m_nodeInstanceStarts[n];
+		const unsigned instanceCount = m_nodeInstanceStarts[n + 1] - firstInstance;
+		if (instanceCount == 0)
+		{
+			continue;
+		}
+
+		for (Mesh* mesh : m_nodeMeshes[n])
+		{
+			shaderProgram->setUniform (hasTexture, mesh->hasTexture());
+			if (mesh->hasTexture())
+			{
+				m_textures[mesh->textureFilePath]->bind();
+				mesh->drawInstanced(m_instances, firstInstance, instanceCount);
+				m_textures[mesh->textureFilePath]->unbind();
+			}
+			else
+			{
+				mesh->drawInstanced(m_instances, firstInstance, instanceCount);
+			}
+		}
+		for (const std::pair<unsigned, unsigned>& subMesh : m_nodeSubMeshes[n])
+		{
+			Mesh* mesh = m_batches[subMesh.first]->getMesh();
+			const IndexRange& range = m_batches[subMesh.first]->getRange(subMesh.second);
+			shaderProgram->setUniform (hasTexture, mesh->hasTexture());
+			if (mesh->hasTexture())
+			{
+				m_textures[mesh->textureFilePath]->bind();
+				mesh->drawInstanced(m_instances, firstInstance, instanceCount, range);
+				m_textures[mesh->textureFilePath]->unbind();
+			}
+			else
+			{
+				mesh->drawInstanced(m_instances, firstInstance, instanceCount, range);
+			}
+		}
+		numTriangles += instanceCount * (m_nodes[n]->numInds / MeshNode::NUM_INDICES_PER_TRIANGLE);
+	}
+	shaderProgram->setUniform ("uInstanced", false);
 	return numTriangles;
 }
 
+void
+Model::setModelUniforms(ShaderProgram* shaderProgram)
+{
+	const unsigned numBones = m_palette.size() < Bone::MAX_BONES ? m_palette.size() : Bone::MAX_BONES;
+	if (m_bone != nullptr && shaderProgram->getUniformBlockIndex("BonePalette") != GL_INVALID_INDEX)
+	{
+		if (m_bonePalette == nullptr)
+		{
+			m_bonePalette = new UniformBuffer(Bone::MAX_BONES * UniformBuffer::MAT4_SIZE, BONE_PALETTE_BINDING);
+		}
+		m_bonePalette->set(0, m_palette.data(), numBones);
+		m_bonePalette->upload();
+		shaderProgram->bindUniformBlock("BonePalette", BONE_PALETTE_BINDING);
+		shaderProgram->setUniform ("hasBones", true);
+	}
+	else if (m_bone != nullptr)
+	{
+		shaderProgram->setUniform ("uBones", m_palette.data(), numBones);
+		shaderProgram->setUniform ("hasBones", true);
+	}
+	else
+	{
+		shaderProgram->setUniform ("hasBones", false);
+	}
+	material.setUniforms(shaderProgram, m_materialData);
+}
+
+
 void
 Model::addCopy(Transform transform)
 {
@@ -8,6 +8,24 @@
 #include "MeshNode.h"
 #include "Debug.h"
 #include "BSPTree.h"
+#include "BVHTree.h"
+#include "CullContext.h"
+#include "BoundsBatch.h"
+#include "UniformBuffer.h"
+#include "RenderQueue.h"
+#include "MeshBatch.h"
+#include "Skeleton.h"
+#include "CpuSkinner.h"
+
+class Model;
+
+// One node of one instance that survived culling
+struct VisibleItem
+{
+	Model* model;
+	unsigned transformIndex;
+	unsigned node;
+};
 
 class Model
 {
@@ -33,6 +51,11 @@ public:
 	unsigned
 	draw(ShaderProgram* shaderProgram, const Camera& camera, SphereDebug& sphere, bool isShaderHandled);
 
+	// Culls with planes already extracted for this frame
+	// Precondition: cullContext was updated with camera
+	unsigned
+	draw(ShaderProgram* shaderProgram, const Camera& camera, const CullContext& cullContext, SphereDebug& sphere);
+
 	void
 	addCopy(Transform transform = Transform());
 
@@ -48,11 +71,128 @@ public:
 	Vector3
 	getCenter();
 
+	// Refresh the instance planes and culling caches before any cullInstance
+	// 	calls of a frame. Not thread safe.
+	void
+	prepareCull(const CullContext& cullContext);
+
+	// World space box around each instance's whole hierarchy, appended in
+	// 	transform order
+	void
+	addInstanceBounds(BoundsBatch& bounds) const;
+
+	// Append the visible nodes of one instance in pre-order. Different
+	// 	instances may be culled on different threads, each with its own
+	// 	planeStack scratch.
+	void
+	cullInstance(unsigned transformIndex, std::vector<std::pair<unsigned, unsigned>>& planeStack,
+		std::vector<VisibleItem>& items);
+
+	// GL thread side of culling, items of an instance must be contiguous and
+	// 	so must the instances of a model. Models that are not instanced go
+	// 	through queue so their meshes are drawn in state order.
+	static unsigned
+	drawVisible(ShaderProgram* shaderProgram, const Camera& camera, const std::vector<VisibleItem>& items,
+		SphereDebug& sphere, RenderQueue& queue);
+
+	// Draw every visible copy of each mesh with one glDrawElementsInstanced
+	// 	call instead of walking the hierarchy once per copy. Debug bounding
+	// 	volumes are not drawn in this mode.
+	void
+	setInstanced(bool isInstanced);
+
+	bool
+	isInstanced() const;
+
+	// Flattened copy of m_bone that animates the palette, nullptr for
+	// 	models without bones
+	Skeleton*
+	getSkeleton();
+
+	// Material and bone palette, the state RenderQueue groups by
+	void
+	setModelUniforms(ShaderProgram* shaderProgram);
+
+	// Binding point of the BonePalette std140 block, used instead of the
+	// 	uBones uniform array when the shader declares that block
+	static constexpr GLuint BONE_PALETTE_BINDING = 0;
+
+	// Models imported after this also build a BSPTree of their polygons,
+	// 	loaded from a .bsp cache beside the file when one matches, and a
+	// 	BVHTree of the same polygons to compare it with. Off by default,
+	// 	nothing draws the trees yet.
+	static void
+	setBuildSpatialIndex(bool isBuilding);
+
+	// Build quality of the two trees, culled from camera's view of the
+	// 	first transform. Prints nothing without spatial indices.
+	void
+	printBuildQuality(const Camera& camera, std::ostream& out = std::cout);
+
 private:
+
+	// Merge the boneless meshes of every node into one MeshBatch per
+	// 	texture, the material is shared by the whole model
+	void
+	batchStaticMeshes();
+
+	void
+	enqueue(RenderQueue& queue, ShaderProgram* shaderProgram, const Transform& view,
+		const std::vector<VisibleItem>& items, unsigned begin, unsigned end);
+
+	// Queue the batch ranges gathered for one instance and reset them
+	void
+	flushBatches(RenderQueue& queue, ShaderProgram* shaderProgram, unsigned instance);
+
+	// Bone palette for this frame, computed once however often it is uploaded,
+	// 	and the skinned meshes streamed with it
+	void
+	updatePalette();
+
+	unsigned
+	drawInstanced(ShaderProgram* shaderProgram, const Transform& view, const std::vector<VisibleItem>& items,
+		unsigned begin, unsigned end);
+
 	MeshNode* root;
+	// The hierarchy in pre-order, see MeshNode::flatten
+	std::vector<MeshNode*> m_nodes;
+	std::vector<unsigned> m_subtreeEnds;
+	std::vector<MeshBatch*> m_batches;
+	// Per node, the (batch, submesh) pairs of its batched meshes and the
+	// 	skinned meshes that are drawn on their own
+	std::vector<std::vector<std::pair<unsigned, unsigned>>> m_nodeSubMeshes;
+	std::vector<std::vector<Mesh*>> m_nodeMeshes;
+	// Visible ranges and nearest depth of each batch for the instance
+	// 	being queued
+	std::vector<std::vector<IndexRange>> m_batchRanges;
+	std::vector<float> m_batchDepths;
+	// Last plane that rejected each node, numNodes entries per transform
+	std::vector<unsigned char> m_lastRejectingPlane;
+	// Frustum of the current camera in the space of each transform
+	InstancePlanes m_instancePlanes;
+	// Used when the model draws itself outside a ModelController
+	std::vector<VisibleItem> m_visibleItems;
+	RenderQueue m_renderQueue;
+	bool m_isInstanced;
+	InstanceBuffer m_instances;
+	// First instance buffer entry of each node, plus the total at the end
+	std::vector<unsigned> m_nodeInstanceStarts;
+	// Only created for shaders with a BonePalette block
+	UniformBuffer* m_bonePalette;
+	UniformBuffer* m_materialData;
+	Skeleton* m_skeleton;
+	// One per skinned mesh, the shader does not skin
+	std::vector<CpuSkinner*> m_skinners;
+	// Palette the draws read, the skeleton's own is written by animation
+	// 	tasks while this one stays as the last frame left it
+	std::vector<Matrix4> m_palette;
+	// Skeleton palette version m_palette and the skinned meshes hold
+	unsigned m_paletteVersion;
 	std::unordered_map<std::string, Texture*> m_textures;
 	std::vector<Transform> m_transforms;
 	BSPTree* bspRoot;
+	BVHTree* m_bvhTree;
+	static bool m_isBuildingSpatialIndex;
 public:
 	Bone* m_bone;
 	std::string name;
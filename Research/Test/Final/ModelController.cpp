@@ -1,15 +1,31 @@
 #include "ModelController.h"
+#include "TaskPool.h"
+#include <algorithm>
 #include <iostream>
 
 ModelController::ModelController()
 	: m_models()
 	, m_indices()
+	, m_cullContext()
+	, m_cullModels()
+	, m_cullStarts()
+	, m_instanceBounds()
+	, m_visibleInstances()
+	, m_taskItems()
+	, m_visibleItems()
+	, m_renderQueue()
+	, m_poseCache()
+	, m_animationLod()
+	, m_animationJobs()
+	, m_animationTasks()
+	, m_animationDelta(0.0f)
 	, m_activeModel(0)
 	, m_activeTransform(0)
 { }
 
 ModelController::~ModelController()
 {
+	waitForAnimation();
 	for (uint i = 0; i < numModel(); ++i)
 	{
 		delete getModel(i);
@@ -28,15 +44,168 @@ ModelController::draw(ShaderProgram* shaderProgram, const Camera& camera, Sphere
 unsigned
 ModelController::draw(ShaderProgram* shaderProgram, const Camera& camera, SphereDebug& sphere, bool isShaderOn)
 {
-	unsigned numTriangles = 0;
+	// Culling overlaps the animation tasks, palettes are read after the fence
+	const std::vector<VisibleItem>& items = buildVisibleList(camera);
+	waitForAnimation();
+	return Model::drawVisible(shaderProgram, camera, items, sphere, m_renderQueue);
+}
+
+const RenderQueue&
+ModelController::getRenderQueue() const
+{
+	return m_renderQueue;
+}
+
+void
+ModelController::animate(float deltaTime, const Camera& camera)
+{
+	waitForAnimation();
+	m_poseCache.beginFrame();
+	m_animationLod.beginFrame();
+	// Visibility comes from the last frame's batched cull, a model drawn
+	// 	since then, or whose instances changed, counts as fully visible
+	unsigned cullIndex = 0;
+	for (uint i = 0; i < numModel(); ++i)
+	{
+		Model* model = getModel(i);
+		Skeleton* skeleton = model->getSkeleton();
+		if (skeleton == nullptr)
+		{
+			continue;
+		}
+		AnimationLod::Level level = AnimationLod::Level::FROZEN;
+		if (isDrawing(i))
+		{
+			const std::vector<uint64_t>* visible = nullptr;
+			unsigned first = 0;
+			std::vector<Model*>::const_iterator culled = std::find(m_cullModels.cbegin() + cullIndex, m_cullModels.cend(), model);
+			if (culled != m_cullModels.cend())
+			{
+				cullIndex = culled - m_cullModels.cbegin();
+				first = m_cullStarts[cullIndex];
+				++cullIndex;
+				const unsigned end = cullIndex < m_cullStarts.size() ? m_cullStarts[cullIndex] : m_instanceBounds.size();
+				if (end - first == model->numTransforms())
+				{
+					visible = &m_visibleInstances;
+				}
+			}
+			level = m_animationLod.chooseLevel(*model, camera, visible, first);
+		}
+		m_animationJobs.push_back({ skeleton, level, false });
+	}
+	m_animationDelta = deltaTime;
+
+	// Frozen skeletons only gather time so they add no bones to a task
+	unsigned begin = 0;
+	unsigned numBones = 0;
+	for (unsigned j = 0; j < m_animationJobs.size(); ++j)
+	{
+		if (m_animationJobs[j].level != AnimationLod::Level::FROZEN)
+		{
+			numBones += m_animationJobs[j].skeleton->size();
+		}
+		if (numBones >= BONES_PER_TASK || j + 1 == m_animationJobs.size())
+		{
+			const unsigned end = j + 1;
+			TaskPool::shared().submit(m_animationTasks, [this, begin, end]() { runAnimationJobs(begin, end); });
+			begin = end;
+			numBones = 0;
+		}
+	}
+}
+
+void
+ModelController::waitForAnimation()
+{
+	if (m_animationJobs.empty())
+	{
+		return;
+	}
+	TaskPool::shared().wait(m_animationTasks);
+	for (const AnimationJob& job : m_animationJobs)
+	{
+		m_animationLod.record(job.level, job.isEvaluated);
+	}
+	m_animationJobs.clear();
+}
+
+void
+ModelController::runAnimationJobs(unsigned begin, unsigned end)
+{
+	for (unsigned j = begin; j < end; ++j)
+	{
+		AnimationJob& job = m_animationJobs[j];
+		job.isEvaluated = job.skeleton->update(m_animationDelta, m_poseCache, AnimationLod::period(job.level));
+	}
+}
+
+const PoseCache&
+ModelController::getPoseCache() const
+{
+	return m_poseCache;
+}
+
+const AnimationLod&
+ModelController::getAnimationLod() const
+{
+	return m_animationLod;
+}
+
+const std::vector<VisibleItem>&
+ModelController::buildVisibleList(const Camera& camera)
+{
+	m_cullContext.update(camera);
+	m_cullModels.clear();
+	m_cullStarts.clear();
+	m_instanceBounds.clear();
+	unsigned numInstances = 0;
 	for (std::pair<Model*, bool> modelPair : m_models)
 	{
 		if (modelPair.second)
 		{
-			numTriangles += modelPair.first->draw(shaderProgram, camera, sphere, true);
+			modelPair.first->prepareCull(m_cullContext);
+			m_cullModels.push_back(modelPair.first);
+			m_cullStarts.push_back(numInstances);
+			numInstances += modelPair.first->numTransforms();
+			modelPair.first->addInstanceBounds(m_instanceBounds);
 		}
 	}
-	return numTriangles;
+	m_instanceBounds.cull(m_cullContext.getWorldFrustum(), m_visibleInstances);
+
+	const unsigned numTasks = (numInstances + INSTANCES_PER_TASK - 1) / INSTANCES_PER_TASK;
+	if (m_taskItems.size() < numTasks)
+	{
+		m_taskItems.resize(numTasks);
+	}
+	TaskPool::shared().parallelFor(0, numInstances, INSTANCES_PER_TASK,
+		[this](unsigned begin, unsigned end)
+		{
+			std::vector<VisibleItem>& items = m_taskItems[begin / INSTANCES_PER_TASK];
+			items.clear();
+			std::vector<std::pair<unsigned, unsigned>> planeStack;
+			// Chunks can span models, find the model owning the first instance
+			unsigned m = std::upper_bound(m_cullStarts.begin(), m_cullStarts.end(), begin) - m_cullStarts.begin() - 1;
+			for (unsigned i = begin; i < end; ++i)
+			{
+				while (m + 1 < m_cullStarts.size() && m_cullStarts[m + 1] <= i)
+				{
+					++m;
+				}
+				if (!BoundsBatch::isVisible(m_visibleInstances, i))
+				{
+					continue;
+				}
+				m_cullModels[m]->cullInstance(i - m_cullStarts[m], planeStack, items);
+			}
+		});
+
+	m_visibleItems.clear();
+	for (unsigned t = 0; t < numTasks; ++t)
+	{
+		m_visibleItems.insert(m_visibleItems.end(), m_taskItems[t].begin(), m_taskItems[t].end());
+	}
+	return m_visibleItems;
 }
 
 void
@@ -104,6 +273,7 @@ ModelController::remove(unsigned index)
 {
 	if (index < m_models.size())
 	{
+		waitForAnimation();
 		Model* model = getModel(index);
 		std::string modelName = model->name;
 		auto iterator = m_indices.find(modelName);
@@ -123,6 +293,7 @@ ModelController::removeAll()
 {
 	if (m_models.size() > 0)
 	{
+		waitForAnimation();
 		for (uint i = 0; i < numModel(); ++i) 
 		{
 			delete getModel(i);
@@ -2,6 +2,8 @@
 
 #include <utility>
 #include "Model.h"
+#include "AnimationLod.h"
+#include "TaskPool.h"
 #include "Debug.h"
 
 class ModelController
@@ -94,11 +96,74 @@ public:
 	// void
 	// printModelInfo();
 
+	// Culls every instance of every drawn model on the task pool into one
+	// 	visible item list, ordered by model then instance
+	const std::vector<VisibleItem>&
+	buildVisibleList(const Camera& camera);
+
+	// State change counts of the last frame's draw
+	const RenderQueue&
+	getRenderQueue() const;
+
+	// Start advancing every animated model at the rate its size on screen
+	// 	calls for, sharing palettes through the pose cache. Skeletons are
+	// 	updated by pool tasks, so they must not be touched until
+	// 	waitForAnimation, which draw calls once culling is done.
+	void
+	animate(float deltaTime, const Camera& camera);
+
+	// Fence for the tasks animate started, skeleton palettes are final after it
+	void
+	waitForAnimation();
+
+	const PoseCache&
+	getPoseCache() const;
+
+	const AnimationLod&
+	getAnimationLod() const;
+
+	// Instances culled by one pool task
+	static constexpr unsigned INSTANCES_PER_TASK = 64;
+	// Bones animated by one pool task, small skeletons share a task
+	static constexpr unsigned BONES_PER_TASK = 256;
+
 private:
+
+	struct AnimationJob
+	{
+		Skeleton* skeleton;
+		AnimationLod::Level level;
+		// Written by the task, read after the fence
+		bool isEvaluated;
+	};
+
+	void
+	runAnimationJobs(unsigned begin, unsigned end);
+
 	//	Overhead is 4 bytes per unique Model and the vector overhead.
 	std::vector<std::pair<Model*, bool>> m_models;
 	std::unordered_map<std::string, unsigned> m_indices;
 
+	// Frustum planes shared by every model drawn in a frame
+	CullContext m_cullContext;
+	// Drawn models and the global index of each one's first instance
+	std::vector<Model*> m_cullModels;
+	std::vector<unsigned> m_cullStarts;
+	// Root box of every drawn instance, culled in one batch before the
+	// 	hierarchies are walked
+	BoundsBatch m_instanceBounds;
+	std::vector<uint64_t> m_visibleInstances;
+	// One list per pool task so no lock is needed, joined in task order
+	std::vector<std::vector<VisibleItem>> m_taskItems;
+	std::vector<VisibleItem> m_visibleItems;
+	RenderQueue m_renderQueue;
+	PoseCache m_poseCache;
+	AnimationLod m_animationLod;
+	// Skeletons being animated, cleared once the fence has counted them
+	std::vector<AnimationJob> m_animationJobs;
+	TaskGroup m_animationTasks;
+	float m_animationDelta;
+
 	unsigned m_activeModel;
 	unsigned m_activeTransform;
 };
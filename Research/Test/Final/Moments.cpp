@@ -0,0 +1,89 @@
+#include "Moments.h"
+
+Moments::Moments()
+: count(0)
+, sumX(0), sumY(0), sumZ(0)
+, sumXX(0), sumXY(0), sumXZ(0)
+, sumYY(0), sumYZ(0)
+, sumZZ(0)
+{ }
+
+void
+Moments::add(float x, float y, float z)
+{
+	count += 1;
+	sumX  += x;
+	sumY  += y;
+	sumZ  += z;
+	sumXX += static_cast<double>(x) * x;
+	sumXY += static_cast<double>(x) * y;
+	sumXZ += static_cast<double>(x) * z;
+	sumYY += static_cast<double>(y) * y;
+	sumYZ += static_cast<double>(y) * z;
+	sumZZ += static_cast<double>(z) * z;
+}
+
+void
+Moments::add(const Vector3& point)
+{
+	add(point.x, point.y, point.z);
+}
+
+void
+Moments::merge(const Moments& other)
+{
+	count += other.count;
+	sumX  += other.sumX;
+	sumY  += other.sumY;
+	sumZ  += other.sumZ;
+	sumXX += other.sumXX;
+	sumXY += other.sumXY;
+	sumXZ += other.sumXZ;
+	sumYY += other.sumYY;
+	sumYZ += other.sumYZ;
+	sumZZ += other.sumZZ;
+}
+
+bool
+Moments::isEmpty() const
+{
+	return count == 0;
+}
+
+Vector3
+Moments::mean() const
+{
+	if (isEmpty())
+	{
+		return Vector3(0);
+	}
+	return Vector3(sumX / count, sumY / count, sumZ / count);
+}
+
+Matrix3
+Moments::covariance() const
+{
+	Matrix3 covarianceMatrix;
+	covarianceMatrix.setToZero();
+	if (count < 2)
+	{
+		return covarianceMatrix;
+	}
+
+	// E[(a - mean a)(b - mean b)] = (sum ab - sum a * sum b / n) / (n - 1)
+	const double divisor = count - 1;
+	const double xx = (sumXX - sumX * sumX / count) / divisor;
+	const double xy = (sumXY - sumX * sumY / count) / divisor;
+	const double xz = (sumXZ - sumX * sumZ / count) / divisor;
+	const double yy = (sumYY - sumY * sumY / count) / divisor;
+	const double yz = (sumYZ - sumY * sumZ / count) / divisor;
+	const double zz = (sumZZ - sumZ * sumZ / count) / divisor;
+
+	covarianceMatrix.setMatrix3
+	(
+		xx, xy, xz,
+		xy, yy, yz,
+		xz, yz, zz
+	);
+	return covarianceMatrix;
+}
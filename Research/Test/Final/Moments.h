@@ -0,0 +1,44 @@
+/*
+  FileName    : Moments.h
+  Author      : Zachary Zuch
+  Description : Running count, sum and the six unique second moments of a
+  				set of points. Gathered in one pass and mergeable, so the mean
+  				and covariance of a mesh (or of a whole hierarchy) can be built
+  				from partial results computed separately.
+*/
+#pragma once
+
+#include "Vector3.h"
+#include "Matrix3.h"
+
+struct Moments
+{
+	Moments();
+
+	void
+	add(float x, float y, float z);
+
+	void
+	add(const Vector3& point);
+
+	void
+	merge(const Moments& other);
+
+	bool
+	isEmpty() const;
+
+	Vector3
+	mean() const;
+
+	// Sample covariance (divided by n - 1) about the mean
+	Matrix3
+	covariance() const;
+
+	// Doubles are used since the raw second moments of large meshes
+	// 	cancel heavily when the mean is subtracted out
+	double count;
+	double sumX, sumY, sumZ;
+	double sumXX, sumXY, sumXZ;
+	double sumYY, sumYZ;
+	double sumZZ;
+};
@@ -0,0 +1,191 @@
+#include <cmath>
+#include <cstring>
+
+#include "PoseCache.h"
+
+/****************************************************************************************/
+// PoseKey Struct
+
+bool
+PoseKey::operator== (const PoseKey& key) const
+{
+	return skeleton == key.skeleton && clip == key.clip && tick == key.tick;
+}
+
+/****************************************************************************************/
+// PoseCacheStats Struct
+
+PoseCacheStats::PoseCacheStats()
+: lookups(0)
+, hits(0)
+, entries(0)
+, bytes(0)
+{ }
+
+float
+PoseCacheStats::hitRate() const
+{
+	return lookups == 0 ? 0.0f : static_cast<float> (hits) / lookups;
+}
+
+/****************************************************************************************/
+// PoseCache Class
+
+PoseCache::PoseCache(float timeStep, unsigned maxAge)
+: m_timeStep(timeStep)
+, m_maxAge(maxAge)
+, m_mutex()
+, m_frame(0)
+, m_entries()
+, m_free()
+, m_current()
+, m_lastFrame()
+{ }
+
+PoseKey
+PoseCache::makeKey(uint64_t skeleton, uint64_t clip, float time) const
+{
+	PoseKey key;
+	key.skeleton = skeleton;
+	key.clip = clip;
+	if (m_timeStep > 0)
+	{
+		key.tick = static_cast<int64_t> (std::floor(time / m_timeStep));
+	}
+	else
+	{
+		// The time's bits, so only equal times share a key
+		uint32_t bits = 0;
+		static_assert(sizeof(bits) == sizeof(time), "float is not 32 bits");
+		std::memcpy(&bits, &time, sizeof(bits));
+		key.tick = bits;
+	}
+	return key;
+}
+
+float
+PoseCache::keyTime(const PoseKey& key) const
+{
+	if (m_timeStep > 0)
+	{
+		return key.tick * m_timeStep;
+	}
+	float time;
+	uint32_t bits = static_cast<uint32_t> (key.tick);
+	std::memcpy(&time, &bits, sizeof(time));
+	return time;
+}
+
+const std::vector<Matrix4>*
+PoseCache::find(const PoseKey& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_current.lookups;
+	auto found = m_entries.find(key);
+	if (found == m_entries.end())
+	{
+		return nullptr;
+	}
+	++m_current.hits;
+	found->second.lastUsed = m_frame;
+	return &found->second.palette;
+}
+
+void
+PoseCache::insert(const PoseKey& key, const std::vector<Matrix4>& palette)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_entries.count(key) != 0)
+	{
+		return;
+	}
+	Entry& entry = m_entries[key];
+	if (!m_free.empty())
+	{
+		entry.palette.swap(m_free.back());
+		m_free.pop_back();
+	}
+	entry.palette.assign(palette.begin(), palette.end());
+	entry.lastUsed = m_frame;
+}
+
+void
+PoseCache::clear()
+{
+	for (auto& keyEntry : m_entries)
+	{
+		m_free.push_back(std::move(keyEntry.second.palette));
+	}
+	m_entries.clear();
+}
+
+void
+PoseCache::beginFrame()
+{
+	for (auto entry = m_entries.begin(); entry != m_entries.end(); )
+	{
+		if (m_frame - entry->second.lastUsed > m_maxAge)
+		{
+			m_free.push_back(std::move(entry->second.palette));
+			entry = m_entries.erase(entry);
+		}
+		else
+		{
+			++entry;
+		}
+	}
+	m_current.entries = m_entries.size();
+	m_current.bytes = sizeInBytes();
+	m_lastFrame = m_current;
+	m_current = PoseCacheStats();
+	++m_frame;
+}
+
+const PoseCacheStats&
+PoseCache::getLastFrameStats() const
+{
+	return m_lastFrame;
+}
+
+void
+PoseCache::printStats(std::ostream& out) const
+{
+	const PoseCacheStats& stats = m_lastFrame;
+	out << "Pose cache: " << stats.hits << " / " << stats.lookups << " hits ("
+		<< 100.0f * stats.hitRate() << "%), "
+		<< stats.entries << " entries, "
+		<< stats.bytes / 1024.0f << " KB" << std::endl;
+}
+
+uint64_t
+PoseCache::hash(const void* data, size_t bytes, uint64_t seed)
+{
+	const unsigned char* byte = static_cast<const unsigned char*> (data);
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		seed ^= byte[i];
+		seed *= 1099511628211ull;
+	}
+	return seed;
+}
+
+size_t
+PoseCache::KeyHash::operator() (const PoseKey& key) const
+{
+	return static_cast<size_t> (hash(&key.tick, sizeof(key.tick), key.skeleton ^ key.clip * 31));
+}
+
+size_t
+PoseCache::sizeInBytes() const
+{
+	size_t bytes = m_entries.size() * (sizeof(PoseKey) + sizeof(Entry));
+	for (const auto& keyEntry : m_entries)
+	{
+		bytes += keyEntry.second.palette.capacity() * sizeof(Matrix4);
+	}
+	for (const std::vector<Matrix4>& palette : m_free)
+	{
+		bytes += palette.capacity() * sizeof(Matrix4);
+	}
+	return bytes;
+}
@@ -0,0 +1,126 @@
+/*
+  FileName    : PoseCache.h
+  Author      : Zachary Zuch
+  Description : Bone palettes of evaluated poses keyed by skeleton, clip and
+  				quantized clip time. Skeletons playing the same clip in
+  				lockstep reuse the palette the first of them computed
+  				instead of sampling and combining their own hierarchy.
+  				Entries unused for a few frames are recycled.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Matrix4.h"
+
+struct PoseKey
+{
+	bool
+	operator== (const PoseKey& key) const;
+
+	// See Skeleton::getSignature and Skeleton::getClipSignature
+	uint64_t skeleton;
+	uint64_t clip;
+	// Clip time in whole time steps
+	int64_t tick;
+};
+
+struct PoseCacheStats
+{
+	PoseCacheStats();
+
+	// Fraction of lookups that found a palette, 0 without lookups
+	float
+	hitRate() const;
+
+	unsigned lookups;
+	unsigned hits;
+	unsigned entries;
+	// Palettes, recycled ones included, and the entries holding them
+	size_t bytes;
+};
+
+class PoseCache
+{
+public:
+
+	// Times within a timeStep of each other share a pose, 0 shares only
+	// 	equal times. Entries unused for more than maxAge frames are recycled.
+	explicit PoseCache(float timeStep = DEFAULT_TIME_STEP, unsigned maxAge = DEFAULT_MAX_AGE);
+
+	// Disable copy ctor and copy assignment
+	PoseCache (const PoseCache&) = delete;
+	PoseCache& operator= (const PoseCache&) = delete;
+
+	PoseKey
+	makeKey(uint64_t skeleton, uint64_t clip, float time) const;
+
+	// Time the pose of key is sampled at, time rounded down to a time step
+	float
+	keyTime(const PoseKey& key) const;
+
+	// nullptr on a miss. find and insert may be called from several threads
+	// 	at once. An inserted palette is never changed, so the one returned
+	// 	can be read without the lock until the next clear or beginFrame.
+	const std::vector<Matrix4>*
+	find(const PoseKey& key);
+
+	// Keeps the palette already stored when another thread inserted key first
+	void
+	insert(const PoseKey& key, const std::vector<Matrix4>& palette);
+
+	void
+	clear();
+
+	// Recycle stale entries and keep the finished frame's counts
+	void
+	beginFrame();
+
+	const PoseCacheStats&
+	getLastFrameStats() const;
+
+	void
+	printStats(std::ostream& out = std::cout) const;
+
+	// FNV-1a over bytes, chained by passing a previous hash as seed
+	static uint64_t
+	hash(const void* data, size_t bytes, uint64_t seed = HASH_SEED);
+
+	static constexpr float DEFAULT_TIME_STEP = 1.0f / 120.0f;
+	static constexpr unsigned DEFAULT_MAX_AGE = 2;
+	static constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+private:
+
+	struct KeyHash
+	{
+		size_t
+		operator() (const PoseKey& key) const;
+	};
+
+	struct Entry
+	{
+		std::vector<Matrix4> palette;
+		unsigned lastUsed;
+	};
+
+	size_t
+	sizeInBytes() const;
+
+	float m_timeStep;
+	unsigned m_maxAge;
+	// Guards the entries, free list and counts during find and insert
+	std::mutex m_mutex;
+	unsigned m_frame;
+	std::unordered_map<PoseKey, Entry, KeyHash> m_entries;
+	// Palettes of recycled entries, reused so steady playback does not allocate
+	std::vector<std::vector<Matrix4>> m_free;
+
+	PoseCacheStats m_current;
+	PoseCacheStats m_lastFrame;
+};
@@ -0,0 +1,279 @@
+#include <cmath>
+
+#include "PositionStream.h"
+#include "Simd.h"
+
+PositionStream::PositionStream()
+: x()
+, y()
+, z()
+{ }
+
+void
+PositionStream::init(const std::vector<float>& vertexData, unsigned floatsPerVertex)
+{
+	unsigned numVertices = vertexData.size() / floatsPerVertex;
+	x.resize(numVertices);
+	y.resize(numVertices);
+	z.resize(numVertices);
+	for (unsigned n = 0; n < numVertices; ++n)
+	{
+		x[n] = vertexData[ floatsPerVertex * n     ];
+		y[n] = vertexData[ floatsPerVertex * n + 1 ];
+		z[n] = vertexData[ floatsPerVertex * n + 2 ];
+	}
+}
+
+void
+PositionStream::clear()
+{
+	// swap so the memory is actually released
+	std::vector<float>().swap(x);
+	std::vector<float>().swap(y);
+	std::vector<float>().swap(z);
+}
+
+unsigned
+PositionStream::size() const
+{
+	return x.size();
+}
+
+bool
+PositionStream::isEmpty() const
+{
+	return x.empty();
+}
+
+Vector3
+PositionStream::sum() const
+{
+	// Float lanes are flushed into doubles every block so large meshes
+	// 	do not lose precision to a single running float
+	constexpr unsigned BLOCK_SIZE = 1024;
+	const unsigned n = size();
+	double total[3] = { 0, 0, 0 };
+
+	for (unsigned begin = 0; begin < n; begin += BLOCK_SIZE)
+	{
+		unsigned end = (begin + BLOCK_SIZE < n) ? begin + BLOCK_SIZE : n;
+		Simd::Lanes sx = Simd::set(0);
+		Simd::Lanes sy = Simd::set(0);
+		Simd::Lanes sz = Simd::set(0);
+
+		unsigned i = begin;
+		for (; i + Simd::WIDTH <= end; i += Simd::WIDTH)
+		{
+			sx = Simd::add(sx, Simd::load(&x[i]));
+			sy = Simd::add(sy, Simd::load(&y[i]));
+			sz = Simd::add(sz, Simd::load(&z[i]));
+		}
+		float tx = Simd::reduceAdd(sx);
+		float ty = Simd::reduceAdd(sy);
+		float tz = Simd::reduceAdd(sz);
+		for (; i < end; ++i)
+		{
+			tx += x[i];
+			ty += y[i];
+			tz += z[i];
+		}
+		total[0] += tx;
+		total[1] += ty;
+		total[2] += tz;
+	}
+	return Vector3(total[0], total[1], total[2]);
+}
+
+void
+PositionStream::getBounds(Vector3& min, Vector3& max) const
+{
+	const unsigned n = size();
+	Simd::Lanes minX = Simd::set(x[0]), maxX = minX;
+	Simd::Lanes minY = Simd::set(y[0]), maxY = minY;
+	Simd::Lanes minZ = Simd::set(z[0]), maxZ = minZ;
+
+	unsigned i = 0;
+	for (; i + Simd::WIDTH <= n; i += Simd::WIDTH)
+	{
+		Simd::Lanes px = Simd::load(&x[i]);
+		Simd::Lanes py = Simd::load(&y[i]);
+		Simd::Lanes pz = Simd::load(&z[i]);
+		minX = Simd::min(minX, px);
+		maxX = Simd::max(maxX, px);
+		minY = Simd::min(minY, py);
+		maxY = Simd::max(maxY, py);
+		minZ = Simd::min(minZ, pz);
+		maxZ = Simd::max(maxZ, pz);
+	}
+
+	min = Vector3(Simd::reduceMin(minX), Simd::reduceMin(minY), Simd::reduceMin(minZ));
+	max = Vector3(Simd::reduceMax(maxX), Simd::reduceMax(maxY), Simd::reduceMax(maxZ));
+	for (; i < n; ++i)
+	{
+		if ( x[i] < min.x ) min.x = x[i];
+		if ( x[i] > max.x ) max.x = x[i];
+		if ( y[i] < min.y ) min.y = y[i];
+		if ( y[i] > max.y ) max.y = y[i];
+		if ( z[i] < min.z ) min.z = z[i];
+		if ( z[i] > max.z ) max.z = z[i];
+	}
+}
+
+void
+PositionStream::getBounds(Vector3& min, Vector3& max, const Matrix3& rotation) const
+{
+	// Matrix3 is column major so r[j * 3 + i] is row i column j
+	const float* r = rotation.data();
+	const Simd::Lanes r00 = Simd::set(r[0]), r01 = Simd::set(r[3]), r02 = Simd::set(r[6]);
+	const Simd::Lanes r10 = Simd::set(r[1]), r11 = Simd::set(r[4]), r12 = Simd::set(r[7]);
+	const Simd::Lanes r20 = Simd::set(r[2]), r21 = Simd::set(r[5]), r22 = Simd::set(r[8]);
+
+	Vector3 first = rotation * Vector3(x[0], y[0], z[0]);
+	Simd::Lanes minX = Simd::set(first.x), maxX = minX;
+	Simd::Lanes minY = Simd::set(first.y), maxY = minY;
+	Simd::Lanes minZ = Simd::set(first.z), maxZ = minZ;
+
+	const unsigned n = size();
+	unsigned i = 0;
+	for (; i + Simd::WIDTH <= n; i += Simd::WIDTH)
+	{
+		Simd::Lanes px = Simd::load(&x[i]);
+		Simd::Lanes py = Simd::load(&y[i]);
+		Simd::Lanes pz = Simd::load(&z[i]);
+
+		Simd::Lanes qx = Simd::mulAdd(r02, pz, Simd::mulAdd(r01, py, Simd::mul(r00, px)));
+		Simd::Lanes qy = Simd::mulAdd(r12, pz, Simd::mulAdd(r11, py, Simd::mul(r10, px)));
+		Simd::Lanes qz = Simd::mulAdd(r22, pz, Simd::mulAdd(r21, py, Simd::mul(r20, px)));
+
+		minX = Simd::min(minX, qx);
+		maxX = Simd::max(maxX, qx);
+		minY = Simd::min(minY, qy);
+		maxY = Simd::max(maxY, qy);
+		minZ = Simd::min(minZ, qz);
+		maxZ = Simd::max(maxZ, qz);
+	}
+
+	min = Vector3(Simd::reduceMin(minX), Simd::reduceMin(minY), Simd::reduceMin(minZ));
+	max = Vector3(Simd::reduceMax(maxX), Simd::reduceMax(maxY), Simd::reduceMax(maxZ));
+	for (; i < n; ++i)
+	{
+		Vector3 point = rotation * Vector3(x[i], y[i], z[i]);
+		if ( point.x < min.x ) min.x = point.x;
+		if ( point.x > max.x ) max.x = point.x;
+		if ( point.y < min.y ) min.y = point.y;
+		if ( point.y > max.y ) max.y = point.y;
+		if ( point.z < min.z ) min.z = point.z;
+		if ( point.z > max.z ) max.z = point.z;
+	}
+}
+
+float
+PositionStream::getMaxDistance(const Vector3& point) const
+{
+	const Simd::Lanes cx = Simd::set(point.x);
+	const Simd::Lanes cy = Simd::set(point.y);
+	const Simd::Lanes cz = Simd::set(point.z);
+	Simd::Lanes farthest = Simd::set(0);
+
+	// Compare squared lengths and only take one square root at the end
+	const unsigned n = size();
+	unsigned i = 0;
+	for (; i + Simd::WIDTH <= n; i += Simd::WIDTH)
+	{
+		Simd::Lanes dx = Simd::sub(Simd::load(&x[i]), cx);
+		Simd::Lanes dy = Simd::sub(Simd::load(&y[i]), cy);
+		Simd::Lanes dz = Simd::sub(Simd::load(&z[i]), cz);
+		Simd::Lanes lengthSquared = Simd::mulAdd(dz, dz, Simd::mulAdd(dy, dy, Simd::mul(dx, dx)));
+		farthest = Simd::max(farthest, lengthSquared);
+	}
+
+	float result = Simd::reduceMax(farthest);
+	for (; i < n; ++i)
+	{
+		float dx = x[i] - point.x;
+		float dy = y[i] - point.y;
+		float dz = z[i] - point.z;
+		float lengthSquared = dx * dx + dy * dy + dz * dz;
+		if ( lengthSquared > result ) result = lengthSquared;
+	}
+	return std::sqrt(result);
+}
+
+void
+PositionStream::accumulate(Moments& moments) const
+{
+	accumulate(moments, 0, size());
+}
+
+void
+PositionStream::accumulate(Moments& moments, unsigned begin, unsigned end) const
+{
+	if (begin >= end) return;
+
+	// Products are taken about the first position so the float lanes only
+	// 	ever hold small numbers, then shifted back into raw moments as doubles
+	const float kx = x[begin];
+	const float ky = y[begin];
+	const float kz = z[begin];
+	const Simd::Lanes shiftX = Simd::set(kx);
+	const Simd::Lanes shiftY = Simd::set(ky);
+	const Simd::Lanes shiftZ = Simd::set(kz);
+
+	constexpr unsigned BLOCK_SIZE = 1024;
+	for (unsigned blockBegin = begin; blockBegin < end; blockBegin += BLOCK_SIZE)
+	{
+		unsigned blockEnd = (blockBegin + BLOCK_SIZE < end) ? blockBegin + BLOCK_SIZE : end;
+		Simd::Lanes sx  = Simd::set(0), sy  = Simd::set(0), sz  = Simd::set(0);
+		Simd::Lanes sxx = Simd::set(0), sxy = Simd::set(0), sxz = Simd::set(0);
+		Simd::Lanes syy = Simd::set(0), syz = Simd::set(0), szz = Simd::set(0);
+
+		unsigned i = blockBegin;
+		for (; i + Simd::WIDTH <= blockEnd; i += Simd::WIDTH)
+		{
+			Simd::Lanes dx = Simd::sub(Simd::load(&x[i]), shiftX);
+			Simd::Lanes dy = Simd::sub(Simd::load(&y[i]), shiftY);
+			Simd::Lanes dz = Simd::sub(Simd::load(&z[i]), shiftZ);
+			sx  = Simd::add(sx, dx);
+			sy  = Simd::add(sy, dy);
+			sz  = Simd::add(sz, dz);
+			sxx = Simd::mulAdd(dx, dx, sxx);
+			sxy = Simd::mulAdd(dx, dy, sxy);
+			sxz = Simd::mulAdd(dx, dz, sxz);
+			syy = Simd::mulAdd(dy, dy, syy);
+			syz = Simd::mulAdd(dy, dz, syz);
+			szz = Simd::mulAdd(dz, dz, szz);
+		}
+
+		double dX  = Simd::reduceAdd(sx),  dY  = Simd::reduceAdd(sy),  dZ  = Simd::reduceAdd(sz);
+		double dXX = Simd::reduceAdd(sxx), dXY = Simd::reduceAdd(sxy), dXZ = Simd::reduceAdd(sxz);
+		double dYY = Simd::reduceAdd(syy), dYZ = Simd::reduceAdd(syz), dZZ = Simd::reduceAdd(szz);
+		for (; i < blockEnd; ++i)
+		{
+			double dx = x[i] - kx;
+			double dy = y[i] - ky;
+			double dz = z[i] - kz;
+			dX  += dx;
+			dY  += dy;
+			dZ  += dz;
+			dXX += dx * dx;
+			dXY += dx * dy;
+			dXZ += dx * dz;
+			dYY += dy * dy;
+			dYZ += dy * dz;
+			dZZ += dz * dz;
+		}
+
+		// sum ab = sum (a - ka)(b - kb) + kb sum (a - ka) + ka sum (b - kb) + n ka kb
+		const double n = blockEnd - blockBegin;
+		moments.count += n;
+		moments.sumX  += dX + n * kx;
+		moments.sumY  += dY + n * ky;
+		moments.sumZ  += dZ + n * kz;
+		moments.sumXX += dXX + 2.0 * kx * dX + n * kx * kx;
+		moments.sumXY += dXY + ky * dX + kx * dY + n * kx * ky;
+		moments.sumXZ += dXZ + kz * dX + kx * dZ + n * kx * kz;
+		moments.sumYY += dYY + 2.0 * ky * dY + n * ky * ky;
+		moments.sumYZ += dYZ + kz * dY + ky * dZ + n * ky * kz;
+		moments.sumZZ += dZZ + 2.0 * kz * dZ + n * kz * kz;
+	}
+}
@@ -0,0 +1,61 @@
+/*
+  FileName    : PositionStream.h
+  Author      : Zachary Zuch
+  Description : Structure-of-arrays copy of a mesh's vertex positions.
+  				The interleaved 8 float layout is kept for the GPU while
+  				the bounding volume passes stream through packed x[], y[], z[]
+  				arrays with AVX2/SSE kernels.
+*/
+#pragma once
+
+#include <vector>
+
+#include "Vector3.h"
+#include "Matrix3.h"
+#include "Moments.h"
+
+struct PositionStream
+{
+	PositionStream();
+
+	// Copy the first three floats of every vertex out of the interleaved data
+	void
+	init(const std::vector<float>& vertexData, unsigned floatsPerVertex);
+
+	void
+	clear();
+
+	unsigned
+	size() const;
+
+	bool
+	isEmpty() const;
+
+	Vector3
+	sum() const;
+
+	// Component wise minimum and maximum of every position
+	// Precondition: the stream is not empty
+	void
+	getBounds(Vector3& min, Vector3& max) const;
+
+	// Bounds of every position after being multiplied by rotation
+	// Precondition: the stream is not empty
+	void
+	getBounds(Vector3& min, Vector3& max, const Matrix3& rotation) const;
+
+	// Add positions [begin, end) to moments in a single pass
+	void
+	accumulate(Moments& moments, unsigned begin, unsigned end) const;
+
+	void
+	accumulate(Moments& moments) const;
+
+	// Largest distance from point to any position
+	float
+	getMaxDistance(const Vector3& point) const;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+};
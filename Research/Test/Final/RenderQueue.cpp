@@ -0,0 +1,280 @@
+#include <cstring>
+#include <numeric>
+
+#include "RenderQueue.h"
+#include "Model.h"
+
+namespace
+{
+	constexpr unsigned NO_INSTANCE = ~0u;
+}
+
+/****************************************************************************************/
+// RenderQueueStats Struct
+
+RenderQueueStats::RenderQueueStats()
+: items(0)
+, programChanges(0)
+, textureChanges(0)
+, materialChanges(0)
+, instanceChanges(0)
+, unsortedChanges(0)
+{ }
+
+unsigned
+RenderQueueStats::issuedChanges() const
+{
+	return programChanges + textureChanges + materialChanges + instanceChanges;
+}
+
+unsigned
+RenderQueueStats::savedChanges() const
+{
+	return unsortedChanges > issuedChanges() ? unsortedChanges - issuedChanges() : 0;
+}
+
+/****************************************************************************************/
+// RenderQueue Class
+
+RenderQueue::RenderQueue()
+: m_items()
+, m_instances()
+, m_ranges()
+, m_order()
+, m_scratch()
+, m_programIds()
+, m_textureIds()
+, m_materialIds()
+, m_stats()
+{ }
+
+void
+RenderQueue::clear()
+{
+	m_items.clear();
+	m_instances.clear();
+	m_ranges.clear();
+	m_order.clear();
+	m_programIds.clear();
+	m_textureIds.clear();
+	m_materialIds.clear();
+}
+
+unsigned
+RenderQueue::addInstance(const Transform& modelView)
+{
+	RenderInstance instance;
+	instance.modelView = modelView.getTransform();
+	instance.normalMatrix = modelView.getOrientation();
+	instance.normalMatrix.invert();
+	instance.normalMatrix.transpose();
+	m_instances.push_back(instance);
+	return m_instances.size() - 1;
+}
+
+void
+RenderQueue::add(ShaderProgram* program, Texture* texture, Model* material, Mesh* mesh, unsigned instance, float depth)
+{
+	uint64_t key = uint64_t(idOf(m_programIds, program, 0xFF)) << PROGRAM_SHIFT
+		| uint64_t(idOf(m_textureIds, texture, 0xFFFF)) << TEXTURE_SHIFT
+		| uint64_t(idOf(m_materialIds, material, 0xFFFF)) << MATERIAL_SHIFT
+		| depthBits(depth);
+	m_items.push_back({ key, program, texture, material, mesh, instance, 0, 0 });
+}
+
+void
+RenderQueue::add(ShaderProgram* program, Texture* texture, Model* material, Mesh* mesh, unsigned instance, float depth,
+	const std::vector<IndexRange>& ranges)
+{
+	add(program, texture, material, mesh, instance, depth);
+	m_items.back().firstRange = m_ranges.size();
+	m_items.back().numRanges = ranges.size();
+	m_ranges.insert(m_ranges.end(), ranges.begin(), ranges.end());
+}
+
+// LSD radix sort, a byte per pass. Passes where every key has the same
+// 	byte are skipped, which is most of them for a single program.
+void
+RenderQueue::sort()
+{
+	const unsigned n = m_items.size();
+	m_order.resize(n);
+	std::iota(m_order.begin(), m_order.end(), 0);
+	m_scratch.resize(n);
+
+	for (unsigned shift = 0; shift < 64; shift += 8)
+	{
+		unsigned counts[256] = { };
+		for (unsigned i = 0; i < n; ++i)
+		{
+			++counts[(m_items[i].key >> shift) & 0xFF];
+		}
+		if (n == 0 || counts[(m_items[0].key >> shift) & 0xFF] == n)
+		{
+			continue;
+		}
+
+		unsigned offset = 0;
+		for (unsigned& count : counts)
+		{
+			unsigned bucket = count;
+			count = offset;
+			offset += bucket;
+		}
+		for (unsigned index : m_order)
+		{
+			m_scratch[counts[(m_items[index].key >> shift) & 0xFF]++] = index;
+		}
+		m_order.swap(m_scratch);
+	}
+}
+
+unsigned
+RenderQueue::submit()
+{
+	RenderQueueStats unsorted;
+	std::vector<unsigned> added(m_items.size());
+	std::iota(added.begin(), added.end(), 0);
+	countChanges(added, unsorted);
+	m_stats = RenderQueueStats();
+	countChanges(m_order, m_stats);
+	m_stats.unsortedChanges = unsorted.issuedChanges();
+
+	unsigned numTriangles = 0;
+	ShaderProgram* program = nullptr;
+	Texture* texture = nullptr;
+	Model* material = nullptr;
+	unsigned instance = NO_INSTANCE;
+	ShaderProgram::Uniform<Matrix4> modelView = { -1 };
+	ShaderProgram::Uniform<Matrix3> normalMatrix = { -1 };
+	ShaderProgram::Uniform<bool> hasTexture = { -1 };
+	for (unsigned index : m_order)
+	{
+		const RenderItem& item = m_items[index];
+		const bool isNewProgram = item.program != program;
+		if (isNewProgram)
+		{
+			program = item.program;
+			program->enable();
+			modelView = program->getUniform<Matrix4>("uModelView");
+			normalMatrix = program->getUniform<Matrix3>("uNormalMatrix");
+			hasTexture = program->getUniform<bool>("uHasTexture");
+			material = nullptr;
+			instance = NO_INSTANCE;
+		}
+		if (isNewProgram || item.texture != texture)
+		{
+			if (item.texture != nullptr)
+			{
+				item.texture->bind();
+			}
+			else if (texture != nullptr)
+			{
+				texture->unbind();
+			}
+			program->setUniform(hasTexture, item.texture != nullptr);
+			texture = item.texture;
+		}
+		if (item.material != material)
+		{
+			material = item.material;
+			material->setModelUniforms(program);
+		}
+		if (item.instance != instance)
+		{
+			instance = item.instance;
+			program->setUniform(modelView, m_instances[instance].modelView);
+			program->setUniform(normalMatrix, m_instances[instance].normalMatrix);
+		}
+		if (item.numRanges == 0)
+		{
+			item.mesh->draw();
+			numTriangles += item.mesh->numIndices() / 3;
+		}
+		else
+		{
+			item.mesh->draw(&m_ranges[item.firstRange], item.numRanges);
+			for (unsigned r = item.firstRange; r < item.firstRange + item.numRanges; ++r)
+			{
+				numTriangles += m_ranges[r].count / 3;
+			}
+		}
+	}
+	if (texture != nullptr)
+	{
+		texture->unbind();
+	}
+	return numTriangles;
+}
+
+const RenderQueueStats&
+RenderQueue::getStats() const
+{
+	return m_stats;
+}
+
+void
+RenderQueue::printStats(std::ostream& out) const
+{
+	out << "Render queue: " << m_stats.items << " items, "
+		<< m_stats.issuedChanges() << " state changes ("
+		<< m_stats.programChanges << " program, "
+		<< m_stats.textureChanges << " texture, "
+		<< m_stats.materialChanges << " material, "
+		<< m_stats.instanceChanges << " instance), "
+		<< m_stats.savedChanges() << " saved over the unsorted order" << std::endl;
+}
+
+unsigned
+RenderQueue::size() const
+{
+	return m_items.size();
+}
+
+unsigned
+RenderQueue::idOf(std::unordered_map<const void*, unsigned>& ids, const void* pointer, unsigned limit)
+{
+	if (pointer == nullptr)
+	{
+		return 0;
+	}
+	auto found = ids.find(pointer);
+	if (found != ids.end())
+	{
+		return found->second;
+	}
+	// Past the limit ids share the last value, only the sort quality suffers
+	unsigned id = ids.size() + 1 < limit ? ids.size() + 1 : limit;
+	ids.emplace(pointer, id);
+	return id;
+}
+
+uint64_t
+RenderQueue::depthBits(float depth)
+{
+	// Behind the eye sorts first like depth 0
+	if (!(depth > 0))
+	{
+		return 0;
+	}
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return bits >> 8;
+}
+
+void
+RenderQueue::countChanges(const std::vector<unsigned>& order, RenderQueueStats& stats) const
+{
+	stats.items = order.size();
+	const RenderItem* last = nullptr;
+	for (unsigned index : order)
+	{
+		const RenderItem& item = m_items[index];
+		const bool isNewProgram = last == nullptr || item.program != last->program;
+		stats.programChanges += isNewProgram;
+		stats.textureChanges += isNewProgram || item.texture != last->texture;
+		stats.materialChanges += isNewProgram || item.material != last->material;
+		stats.instanceChanges += isNewProgram || item.instance != last->instance;
+		last = &item;
+	}
+}
@@ -0,0 +1,134 @@
+/*
+  FileName    : RenderQueue.h
+  Author      : Zachary Zuch
+  Description : Draw items collected for a frame, radix sorted on a 64 bit
+  				key of program, texture, material and depth, then submitted
+  				with only the state changes the sorted order needs.
+*/
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "Matrix3.h"
+#include "Matrix4.h"
+#include "Mesh.h"
+#include "ShaderProgram.h"
+#include "Texture.h"
+#include "Transform.h"
+
+class Model;
+
+// Model view and normal matrix shared by every item of one instance
+struct RenderInstance
+{
+	Matrix4 modelView;
+	Matrix3 normalMatrix;
+};
+
+struct RenderItem
+{
+	uint64_t key;
+	ShaderProgram* program;
+	// nullptr when the mesh is untextured
+	Texture* texture;
+	// Owner of the material and bone palette uniforms
+	Model* material;
+	Mesh* mesh;
+	unsigned instance;
+	// Index ranges of mesh to draw, the whole mesh when numRanges is 0
+	unsigned firstRange;
+	unsigned numRanges;
+};
+
+// State changes issued for the sorted queue, and how many the same items
+// 	would have cost in the order they were added
+struct RenderQueueStats
+{
+	RenderQueueStats();
+
+	unsigned
+	issuedChanges() const;
+
+	unsigned
+	savedChanges() const;
+
+	unsigned items;
+	unsigned programChanges;
+	unsigned textureChanges;
+	unsigned materialChanges;
+	unsigned instanceChanges;
+	unsigned unsortedChanges;
+};
+
+class RenderQueue
+{
+public:
+
+	RenderQueue();
+
+	void
+	clear();
+
+	// Returns the index items of this instance refer to
+	unsigned
+	addInstance(const Transform& modelView);
+
+	// depth is the eye space distance used to order items with equal state
+	void
+	add(ShaderProgram* program, Texture* texture, Model* material, Mesh* mesh, unsigned instance, float depth);
+
+	// Draw only ranges of mesh, with one multi-draw call
+	void
+	add(ShaderProgram* program, Texture* texture, Model* material, Mesh* mesh, unsigned instance, float depth,
+		const std::vector<IndexRange>& ranges);
+
+	void
+	sort();
+
+	// Draws every item and returns the number of triangles
+	// Precondition: sort was called after the last add
+	unsigned
+	submit();
+
+	const RenderQueueStats&
+	getStats() const;
+
+	void
+	printStats(std::ostream& out = std::cout) const;
+
+	unsigned
+	size() const;
+
+	// 8 bits of program, 16 of texture, 16 of material and 24 of depth
+	static constexpr unsigned PROGRAM_SHIFT = 56;
+	static constexpr unsigned TEXTURE_SHIFT = 40;
+	static constexpr unsigned MATERIAL_SHIFT = 24;
+
+private:
+
+	// Small ids in first seen order, 0 is kept for nullptr
+	static unsigned
+	idOf(std::unordered_map<const void*, unsigned>& ids, const void* pointer, unsigned limit);
+
+	// Positive float bits sort like the floats, keep the top 24
+	static uint64_t
+	depthBits(float depth);
+
+	// Changes needed to submit m_items in the order given
+	void
+	countChanges(const std::vector<unsigned>& order, RenderQueueStats& stats) const;
+
+	std::vector<RenderItem> m_items;
+	std::vector<RenderInstance> m_instances;
+	std::vector<IndexRange> m_ranges;
+	// Item indices, sorted by key
+	std::vector<unsigned> m_order;
+	std::vector<unsigned> m_scratch;
+	std::unordered_map<const void*, unsigned> m_programIds;
+	std::unordered_map<const void*, unsigned> m_textureIds;
+	std::unordered_map<const void*, unsigned> m_materialIds;
+	RenderQueueStats m_stats;
+};
@@ -8,11 +8,15 @@ Scene::Scene()
 	, models(new ModelController())
 	, lights()
     , sphere()
+    , m_frameData(nullptr)
+    , m_lightData(nullptr)
 { }
 
 Scene::~Scene()
 {
     delete models;
+    delete m_frameData;
+    delete m_lightData;
 }
 
 unsigned
@@ -20,9 +24,35 @@ Scene::draw(ShaderProgram* shaderProgram)
 {
 	shaderProgram->enable ();
 
-	shaderProgram->setUniform ("uProjection", camera.getProjectionMatrix());
+	if (shaderProgram->getUniformBlockIndex("FrameData") != GL_INVALID_INDEX)
+	{
+		if (m_frameData == nullptr)
+		{
+			m_frameData = new UniformBuffer(UniformBuffer::MAT4_SIZE, FRAME_BINDING);
+		}
+		m_frameData->set(0, camera.getProjectionMatrix());
+		m_frameData->upload();
+		shaderProgram->bindUniformBlock("FrameData", FRAME_BINDING);
+	}
+	else
+	{
+		shaderProgram->setUniform ("uProjection", camera.getProjectionMatrix());
+	}
 
-	lights.setUniforms(shaderProgram, camera);
+	if (shaderProgram->getUniformBlockIndex("LightData") != GL_INVALID_INDEX)
+	{
+		if (m_lightData == nullptr)
+		{
+			m_lightData = new UniformBuffer(lights.std140Size(), LIGHT_BINDING);
+		}
+		lights.write(*m_lightData, camera);
+		m_lightData->upload();
+		shaderProgram->bindUniformBlock("LightData", LIGHT_BINDING);
+	}
+	else
+	{
+		lights.setUniforms(shaderProgram, camera);
+	}
 
 	unsigned numTriangles = models->draw(shaderProgram, camera, sphere, true);
 
@@ -53,6 +53,18 @@ public:
 
 	void
 	updateMouseBuffer();
+
+	// Binding points of the FrameData and LightData std140 blocks, used
+	// 	instead of the uProjection and uLight uniforms when the shader
+	// 	declares those blocks
+	static constexpr GLuint FRAME_BINDING = 2;
+	static constexpr GLuint LIGHT_BINDING = 3;
+
+private:
+
+	// Only created for shaders with the matching block
+	UniformBuffer* m_frameData;
+	UniformBuffer* m_lightData;
 };
 
 #endif
\ No newline at end of file
@@ -7,9 +7,11 @@
 #include <memory>
 
 #include "ShaderProgram.h"
+#include "GLState.h"
 
 ShaderProgram::ShaderProgram ()
-    : m_programId (glCreateProgram()), m_vertexShaderId (0), m_fragmentShaderId (0)
+    : m_programId (glCreateProgram()), m_vertexShaderId (0), m_fragmentShaderId (0),
+      m_uniformLocations (), m_uniformBlockIndices ()
 {
 }
 
@@ -19,7 +21,7 @@ ShaderProgram::~ShaderProgram ()
   // We assume shaders are not shared among multiple programs.
   glDeleteShader (m_vertexShaderId);
   glDeleteShader (m_fragmentShaderId);
-  glDeleteProgram (m_programId);
+  GLState::current ().deleteProgram (m_programId);
 }
 
 GLint
@@ -31,49 +33,160 @@ ShaderProgram::getAttributeLocation (const std::string& attributeName) const
 GLint
 ShaderProgram::getUniformLocation (const std::string& uniformName) const
 {
-  return glGetUniformLocation (m_programId, uniformName.c_str ());
+  auto cached = m_uniformLocations.find (uniformName);
+  if (cached != m_uniformLocations.end ())
+  {
+    return cached->second;
+  }
+  GLint location = glGetUniformLocation (m_programId, uniformName.c_str ());
+  m_uniformLocations.emplace (uniformName, location);
+  return location;
 }
 
 void
 ShaderProgram::setUniform (const std::string& uniform, const Matrix4& value)
 {
-  GLint location = this->getUniformLocation (uniform);
-  glUniformMatrix4fv (location, 1, GL_FALSE, value.data());
+  setUniform (getUniform<Matrix4> (uniform), value);
 }
 
 void
 ShaderProgram::setUniform (const std::string& uniform, const Matrix3& value)
 {
-  GLint location = this->getUniformLocation (uniform);
-  glUniformMatrix3fv (location, 1, GL_FALSE, value.data());
+  setUniform (getUniform<Matrix3> (uniform), value);
 }
 
 void
 ShaderProgram::setUniform (const std::string& uniform, const Vector3& value)
 {
-  GLint location = this->getUniformLocation (uniform);
-  glUniform3fv (location, 1, value.data());
+  setUniform (getUniform<Vector3> (uniform), value);
 }
 
 void
 ShaderProgram::setUniform (const std::string& uniform, float value)
 {
-  GLint location = this->getUniformLocation (uniform);
-  glUniform1f (location, value);
+  setUniform (getUniform<float> (uniform), value);
 }
 
 void
 ShaderProgram::setUniform (const std::string& uniform, int value)
 {
-  GLint location = this->getUniformLocation (uniform);
-  glUniform1i (location, value);
+  setUniform (getUniform<int> (uniform), value);
 }
 
 void
 ShaderProgram::setUniform (const std::string& uniform, bool value)
 {
-  GLint location = this->getUniformLocation (uniform);
-  glUniform1i (location, static_cast<int>(value));
+  setUniform (getUniform<bool> (uniform), value);
+}
+
+void
+ShaderProgram::setUniform (const std::string& uniform, const Matrix4* values, unsigned count)
+{
+  setUniform (getUniform<Matrix4> (uniform), values, count);
+}
+
+void
+ShaderProgram::setUniform (Uniform<Matrix4> uniform, const Matrix4& value)
+{
+  glUniformMatrix4fv (uniform.location, 1, GL_FALSE, value.data());
+}
+
+void
+ShaderProgram::setUniform (Uniform<Matrix3> uniform, const Matrix3& value)
+{
+  glUniformMatrix3fv (uniform.location, 1, GL_FALSE, value.data());
+}
+
+void
+ShaderProgram::setUniform (Uniform<Vector3> uniform, const Vector3& value)
+{
+  glUniform3fv (uniform.location, 1, value.data());
+}
+
+void
+ShaderProgram::setUniform (Uniform<float> uniform, float value)
+{
+  glUniform1f (uniform.location, value);
+}
+
+void
+ShaderProgram::setUniform (Uniform<int> uniform, int value)
+{
+  glUniform1i (uniform.location, value);
+}
+
+void
+ShaderProgram::setUniform (Uniform<bool> uniform, bool value)
+{
+  glUniform1i (uniform.location, static_cast<int>(value));
+}
+
+void
+ShaderProgram::setUniform (Uniform<Matrix4> uniform, const Matrix4* values, unsigned count)
+{
+  // Matrix4 is four packed Vector4 columns so an array of them is column major floats
+  static_assert (sizeof (Matrix4) == 16 * sizeof (float), "Matrix4 must be 16 packed floats");
+  glUniformMatrix4fv (uniform.location, count, GL_FALSE, values->data());
+}
+
+GLuint
+ShaderProgram::getUniformBlockIndex (const std::string& blockName) const
+{
+  auto cached = m_uniformBlockIndices.find (blockName);
+  if (cached != m_uniformBlockIndices.end ())
+  {
+    return cached->second;
+  }
+  GLuint blockIndex = glGetUniformBlockIndex (m_programId, blockName.c_str ());
+  m_uniformBlockIndices.emplace (blockName, blockIndex);
+  return blockIndex;
+}
+
+void
+ShaderProgram::bindUniformBlock (const std::string& blockName, GLuint bindingPoint)
+{
+  GLuint blockIndex = getUniformBlockIndex (blockName);
+  if (blockIndex != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding (m_programId, blockIndex, bindingPoint);
+  }
+}
+
+// Resolve every active uniform once. Arrays are stored under their bare
+//   name and under every element name so either can be looked up.
+void
+ShaderProgram::cacheUniformLocations ()
+{
+  m_uniformLocations.clear ();
+  m_uniformBlockIndices.clear ();
+  GLint numUniforms = 0;
+  GLint maxNameLength = 0;
+  glGetProgramiv (m_programId, GL_ACTIVE_UNIFORMS, &numUniforms);
+  glGetProgramiv (m_programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+  std::unique_ptr<char[]> nameBuffer (new char[maxNameLength + 1]);
+  for (GLint i = 0; i < numUniforms; ++i)
+  {
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform (m_programId, i, maxNameLength + 1, nullptr, &size, &type, nameBuffer.get ());
+    std::string name (nameBuffer.get ());
+    const std::string arraySuffix = "[0]";
+    if (name.size () > arraySuffix.size ()
+        && name.compare (name.size () - arraySuffix.size (), arraySuffix.size (), arraySuffix) == 0)
+    {
+      std::string base = name.substr (0, name.size () - arraySuffix.size ());
+      for (GLint element = 0; element < size; ++element)
+      {
+        std::string elementName = base + "[" + std::to_string (element) + "]";
+        m_uniformLocations[elementName] = glGetUniformLocation (m_programId, elementName.c_str ());
+      }
+      m_uniformLocations[base] = m_uniformLocations[name];
+    }
+    else
+    {
+      m_uniformLocations[name] = glGetUniformLocation (m_programId, name.c_str ());
+    }
+  }
 }
 
 void
@@ -123,7 +236,7 @@ ShaderProgram::compileShader (const std::string& shaderFilename,
 }
 
 void
-ShaderProgram::link () const
+ShaderProgram::link ()
 {
   fprintf (stdout, "Linking shader program %d\n", m_programId);
   glLinkProgram (m_programId);
@@ -139,18 +252,19 @@ ShaderProgram::link () const
   // A shader won't be deleted until it is detached.
   glDetachShader (m_programId, m_vertexShaderId);
   glDetachShader (m_programId, m_fragmentShaderId);
+  cacheUniformLocations ();
 }
 
 void
 ShaderProgram::enable ()
 {
-  glUseProgram (m_programId);
+  GLState::current ().useProgram (m_programId);
 }
 
 void
 ShaderProgram::disable ()
 {
-  glUseProgram (0);
+  GLState::current ().unbindProgram ();
 }
 
 std::string
@@ -5,6 +5,7 @@
 #define SHADER_PROGRAM_H
 
 #include <string>
+#include <unordered_map>
 
 #include <GL/glew.h>
 
@@ -26,9 +27,25 @@ public:
   GLint
   getAttributeLocation (const std::string& attributeName) const;
 
+  // Locations are cached at link time, names the program does not use
+  //   are cached as -1 the first time they are asked for
   GLint
   getUniformLocation (const std::string& uniformName) const;
 
+  // Typed location of a uniform, hold it to skip the name lookup entirely
+  template <typename T>
+  struct Uniform
+  {
+    GLint location;
+  };
+
+  template <typename T>
+  Uniform<T>
+  getUniform (const std::string& uniformName) const
+  {
+    return { getUniformLocation (uniformName) };
+  }
+
   void
   setUniform (const std::string& uniform, const Matrix4& value);
 
@@ -47,6 +64,41 @@ public:
   void
   setUniform (const std::string& uniform, bool value);
 
+  // Set count consecutive elements of a uniform array in one call,
+  //   uniform names the array
+  void
+  setUniform (const std::string& uniform, const Matrix4* values, unsigned count);
+
+  void
+  setUniform (Uniform<Matrix4> uniform, const Matrix4& value);
+
+  void
+  setUniform (Uniform<Matrix3> uniform, const Matrix3& value);
+
+  void
+  setUniform (Uniform<Vector3> uniform, const Vector3& value);
+
+  void
+  setUniform (Uniform<float> uniform, float value);
+
+  void
+  setUniform (Uniform<int> uniform, int value);
+
+  void
+  setUniform (Uniform<bool> uniform, bool value);
+
+  void
+  setUniform (Uniform<Matrix4> uniform, const Matrix4* values, unsigned count);
+
+  // GL_INVALID_INDEX when the program has no uniform block by that name,
+  //   cached like uniform locations
+  GLuint
+  getUniformBlockIndex (const std::string& blockName) const;
+
+  // Read the named block from the buffer bound at bindingPoint
+  void
+  bindUniformBlock (const std::string& blockName, GLuint bindingPoint);
+
   void
   createVertexShader (const std::string& vertexShaderFilename);
 
@@ -54,7 +106,7 @@ public:
   createFragmentShader (const std::string& fragmentShaderFilename);
 
   void
-  link () const;
+  link ();
 
   void
   enable ();
@@ -63,6 +115,9 @@ public:
   disable ();
 
 private:
+  void
+  cacheUniformLocations ();
+
   void
   compileShader (const std::string& shaderFilename, GLuint shaderId);
 
@@ -77,6 +132,8 @@ private:
   GLuint m_programId;
   GLuint m_vertexShaderId;
   GLuint m_fragmentShaderId;
+  mutable std::unordered_map<std::string, GLint> m_uniformLocations;
+  mutable std::unordered_map<std::string, GLuint> m_uniformBlockIndices;
 };
 
 #endif
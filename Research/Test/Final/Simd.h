@@ -0,0 +1,120 @@
+/*
+  FileName    : Simd.h
+  Author      : Zachary Zuch
+  Description : Thin wrapper over the widest float vector the compiler targets.
+  				AVX2 gives 8 lanes, SSE 4 lanes and anything else falls back
+  				to a single float so the kernels are written once.
+*/
+#pragma once
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace Simd
+{
+#if defined(__AVX2__)
+
+	typedef __m256 Lanes;
+	constexpr unsigned WIDTH = 8;
+
+	inline Lanes load (const float* p) 					{ return _mm256_loadu_ps(p); }
+	inline void  store(float* p, Lanes a) 				{ _mm256_storeu_ps(p, a); }
+	inline Lanes set  (float value) 					{ return _mm256_set1_ps(value); }
+	inline Lanes add  (Lanes a, Lanes b) 				{ return _mm256_add_ps(a, b); }
+	inline Lanes sub  (Lanes a, Lanes b) 				{ return _mm256_sub_ps(a, b); }
+	inline Lanes mul  (Lanes a, Lanes b) 				{ return _mm256_mul_ps(a, b); }
+	inline Lanes div  (Lanes a, Lanes b) 				{ return _mm256_div_ps(a, b); }
+	inline Lanes min  (Lanes a, Lanes b) 				{ return _mm256_min_ps(a, b); }
+	inline Lanes max  (Lanes a, Lanes b) 				{ return _mm256_max_ps(a, b); }
+	inline Lanes abs  (Lanes a) 						{ return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	inline Lanes sqrt (Lanes a) 						{ return _mm256_sqrt_ps(a); }
+	// a * b + c
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c)
+	{
+#if defined(__FMA__)
+		return _mm256_fmadd_ps(a, b, c);
+#else
+		return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+	}
+	// One bit per lane, set where a < b
+	inline unsigned lessMask(Lanes a, Lanes b)
+	{
+		return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)));
+	}
+
+#elif defined(__SSE2__)
+
+	typedef __m128 Lanes;
+	constexpr unsigned WIDTH = 4;
+
+	inline Lanes load (const float* p) 					{ return _mm_loadu_ps(p); }
+	inline void  store(float* p, Lanes a) 				{ _mm_storeu_ps(p, a); }
+	inline Lanes set  (float value) 					{ return _mm_set1_ps(value); }
+	inline Lanes add  (Lanes a, Lanes b) 				{ return _mm_add_ps(a, b); }
+	inline Lanes sub  (Lanes a, Lanes b) 				{ return _mm_sub_ps(a, b); }
+	inline Lanes mul  (Lanes a, Lanes b) 				{ return _mm_mul_ps(a, b); }
+	inline Lanes div  (Lanes a, Lanes b) 				{ return _mm_div_ps(a, b); }
+	inline Lanes min  (Lanes a, Lanes b) 				{ return _mm_min_ps(a, b); }
+	inline Lanes max  (Lanes a, Lanes b) 				{ return _mm_max_ps(a, b); }
+	inline Lanes abs  (Lanes a) 						{ return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	inline Lanes sqrt (Lanes a) 						{ return _mm_sqrt_ps(a); }
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) 		{ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline unsigned lessMask(Lanes a, Lanes b)
+	{
+		return static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(a, b)));
+	}
+
+#else
+
+	typedef float Lanes;
+	constexpr unsigned WIDTH = 1;
+
+	inline Lanes load (const float* p) 					{ return *p; }
+	inline void  store(float* p, Lanes a) 				{ *p = a; }
+	inline Lanes set  (float value) 					{ return value; }
+	inline Lanes add  (Lanes a, Lanes b) 				{ return a + b; }
+	inline Lanes sub  (Lanes a, Lanes b) 				{ return a - b; }
+	inline Lanes mul  (Lanes a, Lanes b) 				{ return a * b; }
+	inline Lanes div  (Lanes a, Lanes b) 				{ return a / b; }
+	inline Lanes min  (Lanes a, Lanes b) 				{ return (a < b) ? a : b; }
+	inline Lanes max  (Lanes a, Lanes b) 				{ return (a > b) ? a : b; }
+	inline Lanes abs  (Lanes a) 						{ return (a < 0) ? -a : a; }
+	inline Lanes sqrt (Lanes a) 						{ return __builtin_sqrtf(a); }
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) 		{ return a * b + c; }
+	inline unsigned lessMask(Lanes a, Lanes b) 			{ return (a < b) ? 1u : 0u; }
+
+#endif
+
+	// Horizontal reductions, only used once per kernel call
+	inline float
+	reduceAdd(Lanes a)
+	{
+		float lanes[WIDTH];
+		store(lanes, a);
+		float total = 0;
+		for (unsigned i = 0; i < WIDTH; ++i) total += lanes[i];
+		return total;
+	}
+
+	inline float
+	reduceMin(Lanes a)
+	{
+		float lanes[WIDTH];
+		store(lanes, a);
+		float result = lanes[0];
+		for (unsigned i = 1; i < WIDTH; ++i) if (lanes[i] < result) result = lanes[i];
+		return result;
+	}
+
+	inline float
+	reduceMax(Lanes a)
+	{
+		float lanes[WIDTH];
+		store(lanes, a);
+		float result = lanes[0];
+		for (unsigned i = 1; i < WIDTH; ++i) if (lanes[i] > result) result = lanes[i];
+		return result;
+	}
+}
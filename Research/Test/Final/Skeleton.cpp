@@ -0,0 +1,371 @@
+#include <cmath>
+
+#include "Skeleton.h"
+
+Skeleton::Skeleton(Bone* root)
+: m_parents()
+, m_indices()
+, m_clips()
+, m_compressedClip(nullptr)
+, m_cursors()
+, m_times()
+, m_translations()
+, m_rotations()
+, m_scales()
+, m_locals()
+, m_globals()
+, m_binds()
+, m_poses()
+, m_palette()
+, m_paletteVersion(0)
+, m_fromTranslations()
+, m_fromRotations()
+, m_fromScales()
+, m_toTranslations()
+, m_toRotations()
+, m_toScales()
+, m_pendingTime(0.0f)
+, m_framesSinceUpdate(0)
+, m_signature(0)
+, m_isSignatureDirty(true)
+, m_clipSignature(0)
+, m_isAnimated(true)
+{
+	addBone(root, -1);
+	const unsigned numBones = m_parents.size();
+	m_cursors.resize(numBones);
+	m_times.assign(numBones, 0.0f);
+	m_translations.resize(numBones);
+	m_rotations.assign(numBones, Quaternion(0.0f, 0.0f, 0.0f, 1.0f));
+	m_scales.assign(numBones, Vector3(1.0f, 1.0f, 1.0f));
+	m_poses.resize(numBones);
+	m_palette.resize(numBones);
+	// The keys may be released once compressed, hash them while they exist
+	m_clipSignature = hashClips();
+	sample();
+	computePalette();
+}
+
+Skeleton::~Skeleton()
+{
+	delete m_compressedClip;
+}
+
+void
+Skeleton::addBone(Bone* bone, int parent)
+{
+	// Pre-order, the order Bone::getTransforms builds the palette in
+	const unsigned index = m_parents.size();
+	m_parents.push_back(parent);
+	m_indices.insert({ bone->name, index });
+	m_clips.push_back(bone->animations.empty() ? nullptr : &bone->animations[bone->index]);
+	m_locals.push_back(bone->local);
+	m_globals.push_back(bone->global);
+	m_binds.push_back(bone->bind);
+	for (Bone* child : bone->children)
+	{
+		addBone(child, index);
+	}
+}
+
+void
+Skeleton::update(float deltaTime)
+{
+	if (m_isAnimated)
+	{
+		advance(deltaTime);
+		sample();
+	}
+	computePalette();
+}
+
+void
+Skeleton::update(float deltaTime, PoseCache& cache)
+{
+	if (!m_isAnimated)
+	{
+		computePalette();
+		return;
+	}
+	advance(deltaTime);
+	const PoseKey key = cache.makeKey(getSignature(), m_clipSignature, getTime());
+	const std::vector<Matrix4>* palette = cache.find(key);
+	if (palette != nullptr)
+	{
+		m_palette = *palette;
+		++m_paletteVersion;
+		return;
+	}
+	sample(cache.keyTime(key));
+	computePalette();
+	cache.insert(key, m_palette);
+}
+
+bool
+Skeleton::update(float deltaTime, PoseCache& cache, unsigned period)
+{
+	m_pendingTime += deltaTime;
+	if (period == 0)
+	{
+		return false;
+	}
+	if (period == 1 || !m_isAnimated)
+	{
+		update(m_pendingTime, cache);
+		m_pendingTime = 0.0f;
+		// A later blended level starts over from its first evaluation
+		m_toTranslations.clear();
+		return true;
+	}
+	bool isEvaluated = false;
+	if (m_toTranslations.empty() || ++m_framesSinceUpdate >= period)
+	{
+		advance(m_pendingTime);
+		sample();
+		m_fromTranslations.swap(m_toTranslations);
+		m_fromRotations.swap(m_toRotations);
+		m_fromScales.swap(m_toScales);
+		m_toTranslations = m_translations;
+		m_toRotations = m_rotations;
+		m_toScales = m_scales;
+		if (m_fromTranslations.empty())
+		{
+			m_fromTranslations = m_toTranslations;
+			m_fromRotations = m_toRotations;
+			m_fromScales = m_toScales;
+		}
+		m_pendingTime = 0.0f;
+		m_framesSinceUpdate = 0;
+		isEvaluated = true;
+	}
+	blendPoses(static_cast<float> (m_framesSinceUpdate + 1) / period);
+	computePalette();
+	return isEvaluated;
+}
+
+void
+Skeleton::advance(float deltaTime)
+{
+	for (unsigned i = 0; i < m_clips.size(); ++i)
+	{
+		if (m_clips[i] != nullptr)
+		{
+			m_times[i] = std::fmod(m_times[i] + deltaTime, m_clips[i]->duration);
+		}
+	}
+}
+
+void
+Skeleton::compress(const ClipCompressionSettings& settings)
+{
+	delete m_compressedClip;
+	m_compressedClip = new CompressedClip(m_clips, settings);
+	m_clipSignature = PoseCache::hash(&settings, sizeof(settings), m_clipSignature);
+	// Cursors index the old keys
+	m_cursors.assign(m_cursors.size(), AnimationCursor());
+}
+
+const CompressedClip*
+Skeleton::getCompressedClip() const
+{
+	return m_compressedClip;
+}
+
+void
+Skeleton::sample()
+{
+	for (unsigned i = 0; i < m_clips.size(); ++i)
+	{
+		sampleBone(i, m_times[i]);
+	}
+}
+
+void
+Skeleton::sample(float time)
+{
+	for (unsigned i = 0; i < m_clips.size(); ++i)
+	{
+		sampleBone(i, time);
+	}
+}
+
+void
+Skeleton::sampleBone(unsigned bone, float time)
+{
+	if (m_clips[bone] == nullptr)
+	{
+		return;
+	}
+	if (m_compressedClip != nullptr)
+	{
+		m_compressedClip->getLocalPose(bone, time, m_cursors[bone], m_translations[bone], m_rotations[bone],
+			m_scales[bone]);
+	}
+	else
+	{
+		m_clips[bone]->getLocalPose(time, m_cursors[bone], m_translations[bone], m_rotations[bone],
+			m_scales[bone]);
+	}
+}
+
+void
+Skeleton::computePalette()
+{
+	Transform local;
+	for (unsigned i = 0; i < m_parents.size(); ++i)
+	{
+		if (m_isAnimated && m_clips[i] != nullptr)
+		{
+			local = Transform(m_translations[i], m_rotations[i].toMatrix3());
+			local.innerScale(m_scales[i]);
+		}
+		else
+		{
+			local = m_locals[i];
+		}
+
+		// Parents come first so their pose is already final
+		if (m_parents[i] < 0)
+		{
+			m_poses[i] = local;
+		}
+		else
+		{
+			m_poses[i] = m_poses[m_parents[i]];
+			m_poses[i].combine(local);
+		}
+
+		Transform skin = m_globals[i];
+		skin.combine(m_poses[i]);
+		skin.combine(m_binds[i]);
+		m_palette[i] = skin.getTransform();
+	}
+	++m_paletteVersion;
+}
+
+void
+Skeleton::blendPoses(float weight)
+{
+	// Blending the parts rather than the matrices keeps limbs rigid
+	for (unsigned i = 0; i < m_translations.size(); ++i)
+	{
+		m_translations[i] = m_fromTranslations[i] + (m_toTranslations[i] - m_fromTranslations[i]) * weight;
+		m_rotations[i] = m_fromRotations[i].interpolate(m_toRotations[i], weight);
+		m_scales[i] = m_fromScales[i] + (m_toScales[i] - m_fromScales[i]) * weight;
+	}
+}
+
+const std::vector<Matrix4>&
+Skeleton::getPalette() const
+{
+	return m_palette;
+}
+
+unsigned
+Skeleton::getPaletteVersion() const
+{
+	return m_paletteVersion;
+}
+
+void
+Skeleton::setAnimated(bool isAnimated)
+{
+	m_isAnimated = isAnimated;
+}
+
+bool
+Skeleton::isAnimated() const
+{
+	return m_isAnimated;
+}
+
+void
+Skeleton::setTime(float time)
+{
+	m_times.assign(m_times.size(), time);
+	m_pendingTime = 0.0f;
+}
+
+float
+Skeleton::getTime() const
+{
+	for (unsigned i = 0; i < m_clips.size(); ++i)
+	{
+		if (m_clips[i] != nullptr)
+		{
+			return m_times[i];
+		}
+	}
+	return 0.0f;
+}
+
+uint64_t
+Skeleton::getSignature()
+{
+	if (m_isSignatureDirty)
+	{
+		uint64_t signature = PoseCache::hash(m_parents.data(), m_parents.size() * sizeof(int));
+		for (const std::vector<Transform>* transforms : { &m_locals, &m_globals, &m_binds })
+		{
+			for (const Transform& transform : *transforms)
+			{
+				signature = PoseCache::hash(transform.getTransform().data(), 16 * sizeof(float), signature);
+			}
+		}
+		m_signature = signature;
+		m_isSignatureDirty = false;
+	}
+	return m_signature;
+}
+
+uint64_t
+Skeleton::getClipSignature() const
+{
+	return m_clipSignature;
+}
+
+int
+Skeleton::find(const std::string& name) const
+{
+	auto found = m_indices.find(name);
+	return found == m_indices.end() ? -1 : static_cast<int> (found->second);
+}
+
+int
+Skeleton::getParent(unsigned bone) const
+{
+	return m_parents[bone];
+}
+
+Transform&
+Skeleton::getBindPose(unsigned bone)
+{
+	m_isSignatureDirty = true;
+	return m_binds[bone];
+}
+
+unsigned
+Skeleton::size() const
+{
+	return m_parents.size();
+}
+
+uint64_t
+Skeleton::hashClips() const
+{
+	uint64_t signature = PoseCache::HASH_SEED;
+	for (const Animation* clip : m_clips)
+	{
+		if (clip == nullptr)
+		{
+			signature = PoseCache::hash("", 1, signature);
+			continue;
+		}
+		signature = PoseCache::hash(&clip->duration, sizeof(clip->duration), signature);
+		signature = PoseCache::hash(clip->positions.data(), clip->positions.size() * sizeof(Vector3Key), signature);
+		signature = PoseCache::hash(clip->rotations.data(), clip->rotations.size() * sizeof(QuaternionKey),
+			signature);
+		signature = PoseCache::hash(clip->scalings.data(), clip->scalings.size() * sizeof(Vector3Key), signature);
+	}
+	return signature;
+}
@@ -0,0 +1,180 @@
+/*
+  FileName    : Skeleton.h
+  Author      : Zachary Zuch
+  Description : Flattened copy of a Bone hierarchy. Bones are stored parents
+  				first with the index of their parent, local poses are kept
+  				as separate translation, rotation and scale arrays, and one
+  				loop over the bones builds the skinning palette into buffers
+  				that are allocated once.
+*/
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Animation.h"
+#include "CompressedClip.h"
+#include "PoseCache.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Transform.h"
+
+class Skeleton
+{
+public:
+
+	// root keeps owning the bones and their clips
+	explicit Skeleton(Bone* root);
+
+	~Skeleton();
+
+	// Disable default copy ctor and copy assignment
+	Skeleton (const Skeleton&) = delete;
+	Skeleton& operator= (const Skeleton&) = delete;
+
+	// Advance every bone's clip and rebuild the palette
+	void
+	update(float deltaTime);
+
+	// Same, but the palette is taken from cache when a skeleton with the same
+	// 	signature already evaluated this clip at the same quantized time.
+	// 	The local poses are only sampled on a miss.
+	void
+	update(float deltaTime, PoseCache& cache);
+
+	// Level of detail update. The clip is only evaluated every period frames,
+	// 	over the time gathered since, and the frames between blend the local
+	// 	poses from the previous evaluation toward the latest so the pose
+	// 	trails by up to period - 1 frames. Blended levels sample directly,
+	// 	cache only holds palettes. A period of 0 only gathers time. Returns
+	// 	whether the clip was evaluated.
+	bool
+	update(float deltaTime, PoseCache& cache, unsigned period);
+
+	// Pack the playing clip of every bone into one CompressedClip and sample
+	// 	from it from then on. The bones' own keys are no longer read so
+	// 	they can be released, see Bone::releaseKeys.
+	void
+	compress(const ClipCompressionSettings& settings = ClipCompressionSettings());
+
+	// nullptr until compress is called
+	const CompressedClip*
+	getCompressedClip() const;
+
+	// Sample the local poses at each bone's current time
+	void
+	sample();
+
+	// Sample every bone's clip at time, leaving the bones' times as they are
+	void
+	sample(float time);
+
+	// Combine the local poses down the hierarchy into the palette
+	void
+	computePalette();
+
+	// Skinning matrix of every bone, in the order uBones expects
+	const std::vector<Matrix4>&
+	getPalette() const;
+
+	// Changes whenever the palette does
+	unsigned
+	getPaletteVersion() const;
+
+	// Bones use their local transforms when not animated
+	void
+	setAnimated(bool isAnimated);
+
+	bool
+	isAnimated() const;
+
+	// Restart every clip
+	void
+	setTime(float time);
+
+	// Time of the first animated bone, bones of one clip share it
+	float
+	getTime() const;
+
+	// Hash of the hierarchy and its local, global and bind transforms, equal
+	// 	for skeletons loaded from the same file
+	uint64_t
+	getSignature();
+
+	// Hash of the playing clip of every bone and how it is compressed
+	uint64_t
+	getClipSignature() const;
+
+	// Index of the named bone, or -1
+	int
+	find(const std::string& name) const;
+
+	int
+	getParent(unsigned bone) const;
+
+	// Changes to the pose change the signature
+	Transform&
+	getBindPose(unsigned bone);
+
+	unsigned
+	size() const;
+
+private:
+
+	void
+	addBone(Bone* bone, int parent);
+
+	// Step every clip's time, looping at its duration
+	void
+	advance(float deltaTime);
+
+	void
+	sampleBone(unsigned bone, float time);
+
+	uint64_t
+	hashClips() const;
+
+	// Local poses between the last two evaluated ones
+	void
+	blendPoses(float weight);
+
+	std::vector<int> m_parents;
+	std::unordered_map<std::string, unsigned> m_indices;
+	// Playing clip of each bone, nullptr for bones without a channel
+	std::vector<Animation*> m_clips;
+	CompressedClip* m_compressedClip;
+	std::vector<AnimationCursor> m_cursors;
+	std::vector<float> m_times;
+
+	// Local pose
+	std::vector<Vector3> m_translations;
+	std::vector<Quaternion> m_rotations;
+	std::vector<Vector3> m_scales;
+
+	std::vector<Transform> m_locals;
+	std::vector<Transform> m_globals;
+	std::vector<Transform> m_binds;
+
+	// Pose of each bone in the skeleton's space, then the palette
+	std::vector<Transform> m_poses;
+	std::vector<Matrix4> m_palette;
+	unsigned m_paletteVersion;
+
+	// Local poses of the last two evaluations and the time and frames since
+	// 	the latest, for the level of detail update
+	std::vector<Vector3> m_fromTranslations;
+	std::vector<Quaternion> m_fromRotations;
+	std::vector<Vector3> m_fromScales;
+	std::vector<Vector3> m_toTranslations;
+	std::vector<Quaternion> m_toRotations;
+	std::vector<Vector3> m_toScales;
+	float m_pendingTime;
+	unsigned m_framesSinceUpdate;
+
+	uint64_t m_signature;
+	bool m_isSignatureDirty;
+	uint64_t m_clipSignature;
+
+	bool m_isAnimated;
+};
@@ -0,0 +1,144 @@
+/*
+  FileName    : SymmetricEigen.h
+  Author      : Zachary Zuch
+  Description : Header only eigen decomposition of real symmetric 3x3 matrices
+  				using cyclic Jacobi rotations. Nothing is allocated and every
+  				function is constexpr, so covariance matrices can be diagonalized
+  				by the thousands without any malloc traffic.
+*/
+#pragma once
+
+namespace SymmetricEigen
+{
+	struct Result3
+	{
+		// Sorted largest first
+		float values[3];
+		// vectors[k] is the unit eigenvector for values[k]
+		float vectors[3][3];
+	};
+
+	// Newton iteration so the solver stays usable in constant expressions
+	constexpr double
+	squareRoot(double x)
+	{
+		if (x <= 0) return 0;
+		double guess = (x > 1) ? x : 1;
+		for (unsigned i = 0; i < 128; ++i)
+		{
+			double next = 0.5 * (guess + x / guess);
+			if (next >= guess) break;
+			guess = next;
+		}
+		return guess;
+	}
+
+	constexpr double
+	absolute(double x)
+	{
+		return (x < 0) ? -x : x;
+	}
+
+	// Upper triangle of the symmetric matrix
+	// [ a00 a01 a02 ]
+	// [  .  a11 a12 ]
+	// [  .   .  a22 ]
+	constexpr Result3
+	solve(float a00, float a01, float a02, float a11, float a12, float a22)
+	{
+		double a[3][3] =
+		{
+			{ a00, a01, a02 },
+			{ a01, a11, a12 },
+			{ a02, a12, a22 }
+		};
+		double v[3][3] =
+		{
+			{ 1, 0, 0 },
+			{ 0, 1, 0 },
+			{ 0, 0, 1 }
+		};
+
+		constexpr unsigned MAX_SWEEPS = 32;
+		constexpr unsigned PAIRS[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+		for (unsigned sweep = 0; sweep < MAX_SWEEPS; ++sweep)
+		{
+			double diagonal = absolute(a[0][0]) + absolute(a[1][1]) + absolute(a[2][2]);
+			double offDiagonal = absolute(a[0][1]) + absolute(a[0][2]) + absolute(a[1][2]);
+			// Converged once the off diagonal vanishes relative to the diagonal
+			if (diagonal + offDiagonal == diagonal) break;
+
+			for (unsigned pair = 0; pair < 3; ++pair)
+			{
+				const unsigned p = PAIRS[pair][0];
+				const unsigned q = PAIRS[pair][1];
+				const unsigned r = 3 - p - q;
+				const double apq = a[p][q];
+				if (apq == 0) continue;
+
+				// Rotation angle that zeroes a[p][q]
+				const double theta = (a[q][q] - a[p][p]) / (2 * apq);
+				const double t = (theta >= 0 ? 1.0 : -1.0)
+					/ (absolute(theta) + squareRoot(theta * theta + 1));
+				const double c = 1 / squareRoot(t * t + 1);
+				const double s = t * c;
+
+				a[p][p] -= t * apq;
+				a[q][q] += t * apq;
+				a[p][q] = a[q][p] = 0;
+
+				const double arp = a[r][p];
+				const double arq = a[r][q];
+				a[r][p] = a[p][r] = c * arp - s * arq;
+				a[r][q] = a[q][r] = s * arp + c * arq;
+
+				for (unsigned k = 0; k < 3; ++k)
+				{
+					const double vkp = v[k][p];
+					const double vkq = v[k][q];
+					v[k][p] = c * vkp - s * vkq;
+					v[k][q] = s * vkp + c * vkq;
+				}
+			}
+		}
+
+		// Selection sort the three pairs so the largest eigenvalue is first
+		unsigned order[3] = { 0, 1, 2 };
+		for (unsigned i = 0; i < 2; ++i)
+		{
+			for (unsigned j = i + 1; j < 3; ++j)
+			{
+				if (a[order[j]][order[j]] > a[order[i]][order[i]])
+				{
+					unsigned swap = order[i];
+					order[i] = order[j];
+					order[j] = swap;
+				}
+			}
+		}
+
+		Result3 result {};
+		for (unsigned k = 0; k < 3; ++k)
+		{
+			const unsigned column = order[k];
+			result.values[k] = static_cast<float>(a[column][column]);
+			for (unsigned i = 0; i < 3; ++i)
+			{
+				result.vectors[k][i] = static_cast<float>(v[i][column]);
+			}
+		}
+		return result;
+	}
+
+	// Solve count matrices stored as packed upper triangles
+	// 	(a00, a01, a02, a11, a12, a22) one after another
+	constexpr void
+	solveBatch(const float* packed, unsigned count, Result3* results)
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const float* m = packed + 6 * i;
+			results[i] = solve(m[0], m[1], m[2], m[3], m[4], m[5]);
+		}
+	}
+}
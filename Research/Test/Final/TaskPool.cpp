@@ -0,0 +1,197 @@
+#include "TaskPool.h"
+
+namespace
+{
+	// Which pool and deque the current thread works for, if any
+	thread_local const TaskPool* t_pool = nullptr;
+	thread_local unsigned t_workerIndex = 0;
+}
+
+TaskGroup::TaskGroup()
+: pending(0)
+{ }
+
+bool
+TaskGroup::isDone() const
+{
+	return pending.load(std::memory_order_acquire) == 0;
+}
+
+TaskPool::TaskPool(unsigned numWorkers)
+: m_workers()
+, m_threads()
+, m_queued(0)
+, m_nextWorker(0)
+, m_stopping(false)
+{
+	for (unsigned i = 0; i < numWorkers; ++i)
+	{
+		m_workers.emplace_back(new Worker());
+	}
+	for (unsigned i = 0; i < numWorkers; ++i)
+	{
+		m_threads.emplace_back(&TaskPool::workerLoop, this, i);
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void
+TaskPool::submit(TaskGroup& group, Task task)
+{
+	group.pending.fetch_add(1, std::memory_order_relaxed);
+	if (m_workers.empty())
+	{
+		Job job = { std::move(task), &group };
+		run(job);
+		return;
+	}
+
+	// Workers keep their own forks local, other threads spread theirs out
+	unsigned index = (t_pool == this)
+		? t_workerIndex
+		: m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+	{
+		std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+		m_workers[index]->jobs.push_back({ std::move(task), &group });
+	}
+	m_queued.fetch_add(1, std::memory_order_release);
+
+	// Taking the lock orders this wake up after a sleeper's check
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+void
+TaskPool::wait(TaskGroup& group)
+{
+	unsigned index = (t_pool == this) ? t_workerIndex : m_workers.size();
+	Job job;
+	while (!group.isDone())
+	{
+		if (findJob(index, job))
+		{
+			run(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void
+TaskPool::parallelFor(unsigned begin, unsigned end, unsigned grainSize,
+	const std::function<void(unsigned, unsigned)>& body)
+{
+	if (grainSize == 0) grainSize = 1;
+
+	TaskGroup group;
+	for (unsigned chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+	{
+		unsigned chunkEnd = (end - chunkBegin > grainSize) ? chunkBegin + grainSize : end;
+		submit(group, [&body, chunkBegin, chunkEnd]() { body(chunkBegin, chunkEnd); });
+	}
+	wait(group);
+}
+
+unsigned
+TaskPool::numWorkers() const
+{
+	return m_workers.size();
+}
+
+TaskPool&
+TaskPool::shared()
+{
+	// The thread that waits also runs tasks, so leave it a core
+	static TaskPool pool(std::thread::hardware_concurrency() > 1
+		? std::thread::hardware_concurrency() - 1
+		: 0);
+	return pool;
+}
+
+void
+TaskPool::workerLoop(unsigned index)
+{
+	t_pool = this;
+	t_workerIndex = index;
+
+	Job job;
+	while (true)
+	{
+		if (findJob(index, job))
+		{
+			run(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this]()
+		{
+			return m_stopping || m_queued.load(std::memory_order_acquire) > 0;
+		});
+		if (m_stopping && m_queued.load(std::memory_order_acquire) == 0)
+		{
+			return;
+		}
+	}
+}
+
+bool
+TaskPool::findJob(unsigned index, Job& job)
+{
+	if (m_queued.load(std::memory_order_acquire) == 0)
+	{
+		return false;
+	}
+
+	const unsigned numWorkers = m_workers.size();
+	if (index < numWorkers)
+	{
+		Worker& own = *m_workers[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty())
+		{
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	for (unsigned offset = 1; offset <= numWorkers; ++offset)
+	{
+		Worker& victim = *m_workers[(index + offset) % numWorkers];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty())
+		{
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+TaskPool::run(Job& job)
+{
+	job.task();
+	job.task = nullptr;
+	job.group->pending.fetch_sub(1, std::memory_order_release);
+}
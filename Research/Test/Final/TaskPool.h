@@ -0,0 +1,101 @@
+/*
+  FileName    : TaskPool.h
+  Author      : Zachary Zuch
+  Description : Work stealing thread pool. Every worker owns a deque, pushing
+  				and popping its own work at the back while idle workers steal
+  				from the front of the others. Waiting threads run queued tasks
+  				instead of blocking, so tasks can fork and join recursively.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished tasks submitted under it
+struct TaskGroup
+{
+	TaskGroup();
+
+	// Disable copy ctor and copy assignment
+	TaskGroup (const TaskGroup&) = delete;
+	TaskGroup& operator= (const TaskGroup&) = delete;
+
+	bool
+	isDone() const;
+
+	std::atomic<unsigned> pending;
+};
+
+class TaskPool
+{
+public:
+
+	using Task = std::function<void()>;
+
+	// Zero workers runs every task inline on the submitting thread
+	explicit TaskPool(unsigned numWorkers);
+
+	~TaskPool();
+
+	// Disable copy ctor and copy assignment
+	TaskPool (const TaskPool&) = delete;
+	TaskPool& operator= (const TaskPool&) = delete;
+
+	void
+	submit(TaskGroup& group, Task task);
+
+	// Runs queued tasks until every task in group has finished
+	void
+	wait(TaskGroup& group);
+
+	// Calls body(chunkBegin, chunkEnd) over [begin, end) in chunks of grainSize
+	void
+	parallelFor(unsigned begin, unsigned end, unsigned grainSize,
+		const std::function<void(unsigned, unsigned)>& body);
+
+	unsigned
+	numWorkers() const;
+
+	// Process wide pool with one worker per extra hardware thread
+	static TaskPool&
+	shared();
+
+private:
+
+	struct Job
+	{
+		Task task;
+		TaskGroup* group;
+	};
+
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void
+	workerLoop(unsigned index);
+
+	// Own deque first (newest job), then the oldest job of the others
+	bool
+	findJob(unsigned index, Job& job);
+
+	void
+	run(Job& job);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+
+	std::atomic<unsigned> m_queued;
+	std::atomic<unsigned> m_nextWorker;
+	std::atomic<bool> m_stopping;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+};
@@ -1,4 +1,5 @@
 #include "Texture.h"
+#include "GLState.h"
 #include <iostream>
 
 Texture::Texture(const std::string& filename)
@@ -14,7 +15,7 @@ Texture::Texture(const std::string& filename)
 
 Texture::~Texture()
 {
-	glDeleteTextures(1, &m_textureId);
+	GLState::current().deleteTexture(m_textureId);
     unload();
 }
 
@@ -135,7 +136,7 @@ Texture::setTextureData(const std::string& fileNameString)
 void
 Texture::prepare()
 {
-    glBindTexture(GL_TEXTURE_2D, m_textureId);
+    GLState::current().bindTexture(m_textureId);
     // Upload texture data to OpenGL.
     // Construct the texture.
     // Note: The 'Data format' is the format of the image data as provided by the image library. 
@@ -151,7 +152,7 @@ Texture::prepare()
                  GL_UNSIGNED_BYTE, // Type of texture data
                  m_textureData);   // The image data to use for this texture
     glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::current().unbindTexture(0);
 }
 
 void
@@ -173,8 +174,7 @@ Texture::unload()
 void
 Texture::bind(int index)
 {
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_2D, m_textureId);
+    GLState::current().bindTexture(index, m_textureId);
 }
 
 void
@@ -187,7 +187,7 @@ Texture::bind(ShaderProgram* shaderProgram, int index)
 void
 Texture::unbind()
 {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::current().unbindTexture(0);
 }
 
 GLuint
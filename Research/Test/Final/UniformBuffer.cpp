@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstring>
+
+#include "UniformBuffer.h"
+#include "GLState.h"
+
+UniformBuffer::UniformBuffer(unsigned size, GLuint bindingPoint)
+: m_ubo()
+, m_bindingPoint(bindingPoint)
+, m_data(size, 0)
+, m_dirtyBegin(0)
+, m_dirtyEnd(size)
+{
+	glGenBuffers ( 1, &m_ubo );
+	GLState::current().bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+	glBufferData ( GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW );
+	GLState::current().unbindBuffer(GL_UNIFORM_BUFFER);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	GLState::current().deleteBuffer(m_ubo);
+}
+
+void
+UniformBuffer::set(unsigned offset, const Matrix4& value)
+{
+	write(offset, value.data(), MAT4_SIZE);
+}
+
+void
+UniformBuffer::set(unsigned offset, const Matrix3& value)
+{
+	for (unsigned column = 0; column < 3; ++column)
+	{
+		write(offset + column * VEC4_SIZE, value.data() + 3 * column, 3 * sizeof(float));
+	}
+}
+
+void
+UniformBuffer::set(unsigned offset, const Vector3& value)
+{
+	write(offset, value.data(), 3 * sizeof(float));
+}
+
+void
+UniformBuffer::set(unsigned offset, float value)
+{
+	write(offset, &value, sizeof(float));
+}
+
+void
+UniformBuffer::set(unsigned offset, int value)
+{
+	write(offset, &value, sizeof(int));
+}
+
+void
+UniformBuffer::set(unsigned offset, const Matrix4* values, unsigned count)
+{
+	static_assert(sizeof(Matrix4) == MAT4_SIZE, "Matrix4 must be 16 packed floats");
+	write(offset, values->data(), count * MAT4_SIZE);
+}
+
+void
+UniformBuffer::upload()
+{
+	GLState& state = GLState::current();
+	state.bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+	if (m_dirtyBegin < m_dirtyEnd)
+	{
+		glBufferSubData ( GL_UNIFORM_BUFFER, m_dirtyBegin, m_dirtyEnd - m_dirtyBegin, &m_data[m_dirtyBegin] );
+		m_dirtyBegin = m_data.size();
+		m_dirtyEnd = 0;
+	}
+	state.bindUniformBufferBase(m_bindingPoint, m_ubo);
+	state.unbindBuffer(GL_UNIFORM_BUFFER);
+}
+
+GLuint
+UniformBuffer::getBindingPoint() const
+{
+	return m_bindingPoint;
+}
+
+unsigned
+UniformBuffer::size() const
+{
+	return m_data.size();
+}
+
+void
+UniformBuffer::write(unsigned offset, const void* data, unsigned bytes)
+{
+	// Unchanged values do not widen the upload
+	if (std::memcmp(&m_data[offset], data, bytes) == 0)
+	{
+		return;
+	}
+	std::memcpy(&m_data[offset], data, bytes);
+	m_dirtyBegin = std::min(m_dirtyBegin, offset);
+	m_dirtyEnd = std::max(m_dirtyEnd, offset + bytes);
+}
@@ -0,0 +1,77 @@
+/*
+  FileName    : UniformBuffer.h
+  Author      : Zachary Zuch
+  Description : CPU copy of a std140 uniform block. Values are written at
+  				their std140 offsets and the changed bytes are sent with one
+  				glBufferSubData, instead of one glUniform call per value.
+*/
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include "Matrix4.h"
+#include "Matrix3.h"
+#include "Vector3.h"
+
+class UniformBuffer
+{
+public:
+
+	// size is the block's size in bytes, see GL_UNIFORM_BLOCK_DATA_SIZE
+	UniformBuffer(unsigned size, GLuint bindingPoint);
+
+	~UniformBuffer();
+
+	// Disable default copy ctor and copy assignment
+	UniformBuffer (const UniformBuffer&) = delete;
+	UniformBuffer& operator= (const UniformBuffer&) = delete;
+
+	// Offsets are in bytes and must follow std140 alignment
+	void
+	set(unsigned offset, const Matrix4& value);
+
+	// Each column is padded to a vec4
+	void
+	set(unsigned offset, const Matrix3& value);
+
+	void
+	set(unsigned offset, const Vector3& value);
+
+	void
+	set(unsigned offset, float value);
+
+	// bool and int are both 4 bytes in std140
+	void
+	set(unsigned offset, int value);
+
+	// count consecutive mat4 starting at offset, as in a mat4 array
+	void
+	set(unsigned offset, const Matrix4* values, unsigned count);
+
+	// Send the bytes changed since the last upload and bind to the binding point
+	void
+	upload();
+
+	GLuint
+	getBindingPoint() const;
+
+	unsigned
+	size() const;
+
+	static constexpr unsigned VEC4_SIZE = 4 * sizeof(float);
+	static constexpr unsigned MAT4_SIZE = 4 * VEC4_SIZE;
+	static constexpr unsigned MAT3_SIZE = 3 * VEC4_SIZE;
+
+private:
+
+	void
+	write(unsigned offset, const void* data, unsigned bytes);
+
+	GLuint m_ubo;
+	GLuint m_bindingPoint;
+	std::vector<unsigned char> m_data;
+	// Changed bytes are [m_dirtyBegin, m_dirtyEnd)
+	unsigned m_dirtyBegin;
+	unsigned m_dirtyEnd;
+};
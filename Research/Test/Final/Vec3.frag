@@ -36,8 +36,15 @@ struct Material
 };
 
 const int lightSize = 8;
-uniform Light uLight[lightSize];
-uniform Material uMaterial;
+// std140 offsets are mirrored by Light::write and Material::write
+layout (std140) uniform LightData
+{
+	Light uLight[lightSize];
+};
+layout (std140) uniform MaterialData
+{
+	Material uMaterial;
+};
 
 // Computed vertex color outputted by the vertex shader
 // Type and name must be an exact match
@@ -12,18 +12,28 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aBoneWeight;
 layout (location = 4) in ivec3 aBoneIndices;
+// Per-instance matrices, only read when uInstanced is set
+layout (location = 5) in mat4 aModelView;
+layout (location = 9) in mat3 aNormalMatrix;
 
 /*********************************************************/
 // Uniforms are constant for all vertices from a single
 //   draw call.
 // Specify world and view transform for object.
 //   This matrix should contain Projection * View * World.
-uniform mat4 uProjection;
+layout (std140) uniform FrameData
+{
+	mat4 uProjection;
+};
 uniform mat4 uModelView;
-uniform mat4 uBones[MAX_BONES];
+layout (std140) uniform BonePalette
+{
+	mat4 uBones[MAX_BONES];
+};
 //	 Eye Space Matrix
 uniform mat3 uNormalMatrix;
 uniform bool uHasBones;
+uniform bool uInstanced;
 
 /*********************************************************/
 // Vertex Normal and Position in Eye Space
@@ -34,6 +44,9 @@ out vec2 texCoord;
 void
 main ()
 {
+	mat4 modelView 		= uInstanced ? aModelView 	 : uModelView;
+	mat3 normalMatrix 	= uInstanced ? aNormalMatrix : uNormalMatrix;
+
 	vec4 position;
 	if (false)
 	// if (uHasBones)
@@ -46,17 +59,17 @@ main ()
 		}
 
 		// 		Transform the vertex from world space to clip space
-		position 		= uModelView * BoneMatrix * vec4(aPosition, 1.0);
+		position 		= modelView * BoneMatrix * vec4(aPosition, 1.0);
 		// Transform local/model normal to eye space.
 		// Make sure matrix and vector are normalized prior to calculation to
 		// 		reduce operations.
 		// Normalize in Fragment Shader
-		eyeNormal 		= uNormalMatrix * (BoneMatrix * vec4(aNormal, 1.0)).xyz;
+		eyeNormal 		= normalMatrix * (BoneMatrix * vec4(aNormal, 1.0)).xyz;
 	}
 	else
 	{
-		position 		= uModelView * 	vec4(aPosition, 1.0);
-		eyeNormal 		= uNormalMatrix * aNormal;
+		position 		= modelView * 	vec4(aPosition, 1.0);
+		eyeNormal 		= normalMatrix * aNormal;
 	}
 	
 	eyePos 			= position.xyz;